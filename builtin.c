@@ -205,6 +205,7 @@ static struct option optns[] = {
 	"ignorebraces",'I',
 	"cdablevars",'J',
 	"nobanghist",'K',
+	"profile",'L',
 	NULL,0
 };
 
@@ -306,12 +307,11 @@ int dirs(comm comm)
 
 void listhtable(htable ht,void (*func)(char *,char *))
 {
-int t0;
+int pos = 0;
 struct hnode *hn;
 
-	for (t0 = ht->hsize-1; t0 >= 0; t0--)
-		for (hn = ht->nodes[t0]; hn; hn = hn->hchain)
-			func(hn->nam,hn->dat);
+	while (hn = nexthnode(ht,&pos))
+		func(hn->nam,hn->dat);
 }
 
 /* print an alias (used with listhtable) */
@@ -460,6 +460,26 @@ char *s;
 	return 0;
 }
 
+/* compile scripts for . and source */
+
+int zcompile(comm comm)
+{
+char *s;
+int ret = 0;
+
+	if (!full(comm->args))
+		{
+		zerrnam("zcompile","not enough arguments");
+		return 1;
+		}
+	while (s = getnode(comm->args))
+		{
+		ret |= compfile(s);
+		free(s);
+		}
+	return ret;
+}
+
 int Umask(comm comm)
 {
 char *s,*t;
@@ -507,7 +527,7 @@ char *str = getnode(comm->args),*cnam;
 		}
 	if (gethnode(str,shfunchtab))
 		printf("%s: shell function\n",str);
-	else if (chn = gethnode(str,chtab))
+	else if (chn = hashcmd(str))
 		{
 		if (chn->type != BUILTIN)
 			puts(chn->u.nam);
@@ -731,7 +751,7 @@ char *s;
 		}
 	while (s)
 		{
-		if (!gethnode(s,chtab))
+		if (!hashcmd(s))
 			{
 			zerrnam("unhash","not in command table: %s",s);
 			return 1;
@@ -806,7 +826,7 @@ char *s;
  
 	while (s = getnode(comm->args))
 		{
-		chn = gethnode(s,chtab);
+		chn = hashcmd(s);
 		free(s);
 		if (chn)
 			chn->globstat = GLOB;
@@ -821,7 +841,7 @@ char *s;
  
 	while (s = getnode(comm->args))
 		{
-		chn = gethnode(s,chtab);
+		chn = hashcmd(s);
 		free(s);
 		if (chn)
 			chn->globstat = NOGLOB;
@@ -836,7 +856,7 @@ char *s;
  
 	while (s = getnode(comm->args))
 		{
-		chn = gethnode(s,chtab);
+		chn = hashcmd(s);
 		free(s);
 		if (chn)
 			chn->globstat = MOSTGLOB;
@@ -853,7 +873,7 @@ list l;
 		{
 		unsettrap(s1);
 		if (l = remhnode(s1,shfunchtab))
-			freelist(l);
+			unreflist(l);
 		free(s1);
 		}
 	return 0;
@@ -914,7 +934,7 @@ char *os = s;
 	if (isdigit(*s))
 		{
 		t0 = atoi(s);
-		if (t0 && t0 < MAXJOB && jobtab[t0].stat && t0 != curjob)
+		if (t0 && t0 < maxjob && jobtab[t0].stat && t0 != curjob)
 			{ retval = t0; goto done; }
 		zerrnam(prog,"no such job");
 		retval = -1; goto done;
@@ -923,7 +943,7 @@ char *os = s;
 		{
 		struct procnode *pn;
 
-		for (t0 = 0; t0 != MAXJOB; t0++)
+		for (t0 = 0; t0 != maxjob; t0++)
 			if (jobtab[t0].stat && t0 != curjob)
 				for (pn = jobtab[t0].procs; pn; pn = pn->next)
 					if (strstr(pn->text,s+1))
@@ -931,7 +951,7 @@ char *os = s;
 		zerrnam(prog,"job not found: %s",s);
 		retval = -1; goto done;
 		}
-	for (t0 = 0; t0 != MAXJOB; t0++)
+	for (t0 = 0; t0 != maxjob; t0++)
 		if (jobtab[t0].stat && jobtab[t0].procs && t0 != curjob && 
 				prefix(s,jobtab[t0].procs->text))
 			{ retval = t0; goto done; }
@@ -1056,7 +1076,7 @@ int job,lng = 0;
 			}
 		lng = (strcmp(comm->args->first->dat,"-l")) ? 2 : 1;
 		}
-	for (job = 0; job != MAXJOB; job++)
+	for (job = 0; job != maxjob; job++)
 		if (job != curjob && jobtab[job].stat)
 			printjob(job+jobtab,lng);
 	stopmsg = 2;
@@ -1101,6 +1121,8 @@ char *s;
 			{
 			int job = getjob(s,"kill");
 
+			if (job == -1)
+				return 1;
 			if (killjb(jobtab+job,sig) == -1)
 				{
 				zerrnam("kill","kill failed: %e",errno);
@@ -1501,10 +1523,12 @@ int eval(comm comm)
 {
 char *s = buildline(comm->args);
 list list;
+struct arena *ar;
 
 	hungets(s);
+	free(s);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		hflush();
 		strinend();
@@ -1512,6 +1536,7 @@ list list;
 		}
 	strinend();
 	runlist(list);
+	freearena(ar);
 	return lastval;
 }
 
@@ -1546,12 +1571,38 @@ long val;
 	return !val;
 }
 
+/* read a character for read.  Traps are run while we wait for it,
+	and an interrupt gives up. */
+
+static int readchar(void)
+{
+fd_set fds;
+char cc;
+
+	for (;;)
+		{
+		handlesigs();
+		if (errflag)
+			return EOF;
+		FD_ZERO(&fds);
+		FD_SET(0,&fds);
+		FD_SET(sigfds[0],&fds);
+		if (select(sigfds[0]+1,&fds,NULL,NULL,NULL) == -1)
+			{
+			if (errno == EINTR)
+				continue;
+			return EOF;
+			}
+		if (FD_ISSET(0,&fds))
+			return (read(0,&cc,1) == 1) ? cc : EOF;
+		}
+}
+
 int Read(comm comm)
 {
 char *str,*pmpt;
 int r = 0,bsiz,c,gotnl = 0;
 char *buf,*bptr;
-char cc;
 
 	str = getnode(comm->args);
 	if (str && !strcmp(str,"-r"))
@@ -1577,10 +1628,7 @@ char cc;
 			{
 			if (gotnl)
 				break;
-			if (read(0,&cc,1) == 1)
-				c = cc;
-			else
-				c = EOF;
+			c = readchar();
 			if (c == EOF || znspace(c))
 				break;
 			*bptr++ = c;
@@ -1602,10 +1650,7 @@ char cc;
 	if (!gotnl)
 		FOREVER
 			{
-			if (read(0,&cc,1) == 1)
-				c = cc;
-			else
-				c = EOF;
+			c = readchar();
 			if (c == EOF || c == '\n')
 				break;
 			*bptr++ = c;
@@ -1850,18 +1895,224 @@ int disown(comm comm)
 {
 char *str;
 int t0;
-static struct jobnode zero;
 
 	while (str = getnode(comm->args))
 		{
 		t0 = getjob(str,"disown");
 		if (t0 == -1)
 			return 1;
-		jobtab[t0] = zero;
+		freejob(t0);
+		}
+	return 0;
+}
+
+/* print or clear the profile collected with the profile option */
+
+int zprof(comm comm)
+{
+char *s,*keys[] = {"self","total","cpu","selfcpu","calls","name",NULL};
+int key = PROF_SELF,dump = 0,t0;
+
+	while (s = getnode(comm->args))
+		{
+		if (!strcmp(s,"-c"))
+			{
+			free(s);
+			profclear();
+			return 0;
+			}
+		if (!strcmp(s,"-d"))
+			dump = 1;
+		else if (!strcmp(s,"-k"))
+			{
+			free(s);
+			if (!(s = getnode(comm->args)))
+				{
+				zerrnam("zprof","sort key expected after -k");
+				return 1;
+				}
+			for (t0 = 0; keys[t0]; t0++)
+				if (!strcmp(keys[t0],s))
+					break;
+			if (!keys[t0])
+				{
+				zerrnam("zprof","bad sort key: %s",s);
+				free(s);
+				return 1;
+				}
+			key = t0;
+			}
+		else
+			{
+			zerrnam("zprof","usage: zprof [ -c | -d ] [ -k key ]");
+			free(s);
+			return 1;
+			}
+		free(s);
+		}
+	profreport(key,dump);
+	return 0;
+}
+
+/* start or stop writing trace records of commands to a file or fd */
+
+int ztrace(comm comm)
+{
+char *s;
+int fd;
+
+	if (!(s = getnode(comm->args)))
+		{
+		if (tracefd != -1)
+			close(tracefd);
+		tracefd = -1;
+		return 0;
+		}
+	if (!strcmp(s,"-u"))
+		{
+		free(s);
+		if (!(s = getnode(comm->args)) || !isdigit(*s))
+			{
+			zerrnam("ztrace","fd expected after -u");
+			if (s)
+				free(s);
+			return 1;
+			}
+		fd = dup(atoi(s));
 		}
+	else
+		fd = open(s,O_WRONLY|O_APPEND|O_CREAT,0666);
+	if (fd == -1)
+		{
+		zerrnam("ztrace","%e: %s",errno,s);
+		free(s);
+		return 1;
+		}
+	free(s);
+	if (full(comm->args))
+		{
+		zerrnam("ztrace","too many arguments");
+		close(fd);
+		return 1;
+		}
+	if (tracefd != -1)
+		close(tracefd);
+	tracefd = movefd(fd);
 	return 0;
 }
 
+/* wait for background jobs; return the status of the last one
+	waited for */
+
+int Wait(comm comm)
+{
+char *s;
+int job,ret = 0,anyjob = 0;
+long pid;
+struct procnode *pn;
+struct deadjob *dj;
+
+	s = getnode(comm->args);
+	if (s && !strcmp(s,"-n"))
+		{
+		if (full(comm->args))
+			{
+			zerrnam("wait","too many arguments");
+			return 1;
+			}
+		anyjob = 1;
+		s = NULL;
+		}
+	if (!s)
+		{
+		for (;;)
+			{
+			handlesigs();
+			if (anyjob && (dj = getdead(0,0)))
+				{
+				setiparm(strdup("REPLY"),dj->pid,0);
+				ret = dj->stat;
+				free(dj);
+				return ret;
+				}
+			if (!bgrunning(0))
+				break;
+			if (errflag)
+				return 0200|SIGINT;
+			waitsig();
+			}
+		if (anyjob)
+			return 127;
+		while (dj = getdead(0,0))
+			free(dj);
+		return 0;
+		}
+	for (; s; s = getnode(comm->args))
+		{
+		if (*s == '%' && isdigit(s[1]) && ((job = atoi(s+1)) >= maxjob ||
+				!jobtab[job].stat || job == curjob) && (dj = getdead(job,0)))
+			{
+			free(s);
+			ret = dj->stat;
+			free(dj);
+			continue;
+			}
+		if (*s == '%')
+			{
+			if ((job = getjob(s,"wait")) == -1)	/* this frees s */
+				{
+				ret = 127;
+				continue;
+				}
+			pid = 0;
+			}
+		else
+			{
+			pid = atol(s);
+			free(s);
+			job = (pn = findproc(pid)) ? pn->job : 0;
+			}
+		if (job > 0 && job < maxjob && job != curjob && jobtab[job].stat &&
+				!(jobtab[job].stat & STAT_NOTOURS))
+			{
+			long lastpid;
+
+			for (pn = jobtab[job].procs; pn->next; pn = pn->next);
+			lastpid = pn->pid;
+			while (bgrunning(job) && !errflag)
+				{
+				waitsig();
+				for (pn = jobtab[job].procs; pn && pn->next; pn = pn->next);
+				if (!pn || pn->pid != lastpid)
+					break;
+				}
+			if (errflag)
+				return 0200|SIGINT;
+			if (jobtab[job].stat & STAT_STOPPED)
+				{
+				for (pn = jobtab[job].procs; pn->next; pn = pn->next);
+				ret = 0200|WSTOPSIG(SP(pn->statusp));
+				continue;
+				}
+			pid = lastpid;
+			}
+		if ((dj = getdead(0,pid)) || (!pid && (dj = getdead(job,0))))
+			{
+			ret = dj->stat;
+			free(dj);
+			}
+		else
+			{
+			if (pid)
+				zerrnam("wait","pid %d is not a child of this shell",(int) pid);
+			else
+				zerrnam("wait","job has already been waited for");
+			ret = 127;
+			}
+		}
+	return ret;
+}
+
 int function(comm comm)
 {
 	if (full(comm->args))
@@ -1884,7 +2135,7 @@ int (*funcs[])(comm) = {
 	sched,let,fc,
 	rehash,hash,disown,test,Read,
 	integer,setopt,unsetopt,zreturn,function,
-	test,
+	test,zcompile,dot,Wait,zprof,ztrace,
 	NULL
 	};
 char *funcnams[] = {
@@ -1898,7 +2149,7 @@ char *funcnams[] = {
 	"sched","let","fc",
 	"rehash","hash","disown","test","read",
 	"integer","setopt","unsetopt","return","function",
-	"["
+	"[","zcompile","source","wait","zprof","ztrace"
 	};
 
 int builtin(comm comm)
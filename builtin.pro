@@ -19,6 +19,7 @@ char *buildline(table t);
 int Alias(comm comm);
 int cd(comm comm);
 int dot(comm comm);
+int zcompile(comm comm);
 int Umask(comm comm);
 int which(comm comm);
 int popd(comm comm);
@@ -58,6 +59,9 @@ int fclist(FILE *f,int n,int r,int first,int last,table subs);
 int fcsubs(char **sp,table tab);
 int fcedit(char *ename,char *fn);
 int disown(comm comm);
+int zprof(comm comm);
+int ztrace(comm comm);
+int Wait(comm comm);
 int function(comm comm);
 int builtin(comm comm);
 void addintern(htable ht);
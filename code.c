@@ -0,0 +1,1027 @@
+/*
+
+	code.c - compiling parse trees into wordcode and running it
+
+	This file is part of zsh, the Z shell.
+
+   zsh is free software; no one can prevent you from reading the source
+   code, or giving it to someone else.
+   This file is copyrighted under the GNU General Public License, which
+   can be found in the file called COPYING.
+
+   Copyright (C) 1990 Paul Falstad
+
+   zsh is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY.  No author or distributor accepts
+   responsibility to anyone for the consequences of using it or for
+   whether it serves any particular purpose or works at all, unless he
+   says so in writing.  Refer to the GNU General Public License
+   for full details.
+
+   Everyone is granted permission to copy, modify and redistribute
+   zsh, but only under the conditions described in the GNU General Public
+   License.   A copy of this license is supposed to have been given to you
+   along with zsh so you can know your rights and responsibilities.
+   It should be in a file named COPYING.
+
+   Among other things, the copyright notice and this notice must be
+   preserved on all copies.
+
+*/
+
+#include "zsh.h"
+#include "funcs.h"
+#include <sys/mman.h>
+
+/* compile a list into wordcode allocated from a.  The lists of the
+	tree are pointed at their code, so that execlist will run the code
+	instead of walking the tree; the tree is kept for the compound
+	commands, which are still run by the tree interpreter. */
+
+struct prog *compile(list l,struct arena *a)
+{
+struct wcbuf b;
+struct prog *p = aralloc(a,sizeof(struct prog));
+
+	b.len = b.slen = b.ntrees = b.heredocs = 0;
+	b.code = zalloc((b.csiz = 256)*sizeof(wordcode));
+	b.strs = zalloc(b.ssiz = 1024);
+	b.trees = zalloc((b.tsiz = 16)*sizeof(comm));
+	complist(&b,l,p);
+	p->code = memcpy(aralloc(a,b.len*sizeof(wordcode)),b.code,
+		b.len*sizeof(wordcode));
+	p->strs = memcpy(aralloc(a,b.slen),b.strs,b.slen);
+	p->trees = memcpy(aralloc(a,b.ntrees*sizeof(comm)),b.trees,
+		b.ntrees*sizeof(comm));
+	p->len = b.len;
+	p->slen = b.slen;
+	p->ntrees = b.ntrees;
+	p->heredocs = b.heredocs;
+	p->arena = a;
+	free(b.code);
+	free(b.strs);
+	free(b.trees);
+	return p;
+}
+
+/* add a word to the code */
+
+void wcadd(struct wcbuf *b,wordcode w)
+{
+	if (b->len == b->csiz)
+		b->code = realloc(b->code,(b->csiz *= 2)*sizeof(wordcode));
+	b->code[b->len++] = w;
+}
+
+/* add a string to the string table, returning its offset */
+
+wordcode wcstr(struct wcbuf *b,char *s)
+{
+int l,ret = b->slen;
+
+	if (!s)
+		return WC_NONE;
+	l = strlen(s)+1;
+	while (b->slen+l > b->ssiz)
+		b->strs = realloc(b->strs,b->ssiz *= 2);
+	memcpy(b->strs+b->slen,s,l);
+	b->slen += l;
+	return ret;
+}
+
+void complist(struct wcbuf *b,list l,struct prog *p)
+{
+	for (; l; l = l->right)
+		{
+		l->prog = p;
+		l->pc = b->len;
+		wcadd(b,WCB(WC_LIST,l->type,!l->right | (wordcode) l->lineno << 1));
+		compsublist(b,l->left,p);
+		}
+}
+
+/* compile a list that is part of a compound command, prefixed
+	by its length */
+
+void complistlen(struct wcbuf *b,list l,struct prog *p)
+{
+int n = b->len;
+
+	wcadd(b,0);
+	complist(b,l,p);
+	b->code[n] = b->len-n-1;
+}
+
+void compsublist(struct wcbuf *b,list2 l,struct prog *p)
+{
+pline pl;
+int n;
+
+	for (; l; l = l->right)
+		{
+		n = b->len;
+		wcadd(b,WCB(WC_SUBLIST,l->type,l->flags));
+		wcadd(b,0);
+		for (pl = l->left; pl; pl = pl->right)
+			{
+			wcadd(b,WCB(WC_PIPE,pl->type,0));
+			compcomm(b,pl->left,p);
+			}
+		b->code[n+1] = b->len-n;
+		}
+}
+
+void compcomm(struct wcbuf *b,comm c,struct prog *p)
+{
+int n = b->len;
+Node nd;
+
+	wcadd(b,WCB(WC_CMD,c->type,c->flags));
+	wcadd(b,0);
+	if (c->type == SIMPLE)
+		wcadd(b,0);
+	else
+		{
+		if (b->ntrees == b->tsiz)
+			b->trees = realloc(b->trees,(b->tsiz *= 2)*sizeof(comm));
+		b->trees[b->ntrees] = c;
+		wcadd(b,b->ntrees++);
+		}
+	wcadd(b,wcstr(b,c->cmd));
+	comptable(b,c->args);
+	wcadd(b,wclength(c->redir));
+	for (nd = c->redir->first; nd; nd = nd->next)
+		{
+		struct fnode *f = nd->dat;
+
+		if (f->type == HEREDOC)
+			b->heredocs++;
+		wcadd(b,f->type);
+		wcadd(b,f->fd1);
+		if (f->type < HEREDOC || f->type == INPIPE || f->type == OUTPIPE)
+			wcadd(b,wcstr(b,f->u.name));
+		else
+			wcadd(b,f->u.fd2);
+		}
+	if (c->vars)
+		comptable(b,c->vars);
+	else
+		wcadd(b,WC_NONE);
+	switch (c->type)
+		{
+		case SUBSH:
+		case CURSH:
+			complistlen(b,c->left,p);
+			break;
+		case CFOR:
+		case CSELECT:
+			{
+			struct fornode *f = c->info;
+
+			wcadd(b,wcstr(b,f->name));
+			wcadd(b,f->inflag);
+			wcadd(b,f->par);
+			wcadd(b,f->grpout);
+			complistlen(b,f->list,p);
+			break;
+			}
+		case CWHILE:
+			{
+			struct whilenode *w = c->info;
+
+			wcadd(b,w->cond);
+			complistlen(b,w->cont,p);
+			complistlen(b,w->loop,p);
+			break;
+			}
+		case CREPEAT:
+			{
+			struct repeatnode *r = c->info;
+
+			wcadd(b,r->count);
+			complistlen(b,r->list,p);
+			break;
+			}
+		case CIF:
+			{
+			struct ifnode *i;
+			int ct = 0;
+
+			for (i = c->info; i; i = i->next)
+				ct++;
+			wcadd(b,ct);
+			for (i = c->info; i; i = i->next)
+				{
+				complistlen(b,i->ifl,p);
+				complistlen(b,i->thenl,p);
+				}
+			break;
+			}
+		case CCASE:
+			{
+			struct casenode *cn;
+			int ct = 0;
+
+			for (cn = c->info; cn; cn = cn->next)
+				ct++;
+			wcadd(b,ct);
+			for (cn = c->info; cn; cn = cn->next)
+				{
+				wcadd(b,wcstr(b,cn->pat));
+				complistlen(b,cn->list,p);
+				}
+			break;
+			}
+		}
+	b->code[n+1] = b->len-n;
+}
+
+/* add a table of strings, prefixed by its length */
+
+void comptable(struct wcbuf *b,table t)
+{
+Node n;
+
+	wcadd(b,wclength(t));
+	for (n = t->first; n; n = n->next)
+		wcadd(b,wcstr(b,n->dat));
+}
+
+int wclength(table t)
+{
+Node n;
+int ct = 0;
+
+	for (n = t->first; n; n = n->next)
+		ct++;
+	return ct;
+}
+
+/* run a list from its code; this is execlist for compiled lists */
+
+void execwlist(struct prog *p,wordcode *pc)
+{
+wordcode w;
+int prof;
+struct profframe pf;
+
+	for (;;)
+		{
+		if (breaks)
+			return;
+		w = *pc++;
+		if (prof = isset(PROFILE))
+			profenter(&pf,1);
+		execwlist2(p,pc,wc_type(w),wc_flags(w) & 1);
+		if (prof)
+			proflist(&pf,wc_flags(w) >> 1);
+		if (sigtrapped[SIGDEBUG])
+			dotrap(SIGDEBUG);
+		if (sigtrapped[SIGERR] && lastval)
+			dotrap(SIGERR);
+		if ((wc_flags(w) & 1) || retflag)
+			return;
+		while (wc_type(*pc) != END)	/* skip to the next list */
+			pc += pc[1];
+		pc += pc[1];
+		}
+}
+
+void execwlist2(struct prog *p,wordcode *pc,int type,int last1)
+{
+	for (;; pc += pc[1])
+		switch (wc_type(*pc))
+			{
+			case END:
+				execwpline(p,pc,type,last1);
+				return;
+			case ORNEXT:
+				if (execwpline(p,pc,SYNC,0))
+					return;
+				break;
+			case ANDNEXT:
+				if (!execwpline(p,pc,SYNC,0))
+					return;
+				break;
+			}
+}
+
+int execwpline(struct prog *p,wordcode *pc,int how,int last1)
+{
+struct pstage ps;
+
+	ps.pl = NULL;
+	ps.prog = p;
+	ps.pc = pc+2;
+	return runpline(&ps,wc_flags(*pc),how,last1);
+}
+
+/* the stages of a pipeline for execpline2, from its tree or its code */
+
+int pslast(struct pstage *ps)
+{
+	return (ps->prog) ? wc_type(*ps->pc) == END : ps->pl->type == END;
+}
+
+/* the type of the stage's command */
+
+int pstype(struct pstage *ps)
+{
+	return (ps->prog) ? wc_type(ps->pc[1]) : ps->pl->left->type;
+}
+
+/* the stage after this one */
+
+void psnext(struct pstage *ps,struct pstage *next)
+{
+	*next = *ps;
+	if (ps->prog)
+		next->pc = ps->pc+1+ps->pc[2];
+	else
+		next->pl = ps->pl->right;
+}
+
+void psrun(struct pstage *ps,int input,int output,int bkg,int last1)
+{
+	if (ps->prog)
+		execwcomm(ps->prog,ps->pc+1,input,output,bkg,last1);
+	else
+		execcomm(ps->pl->left,input,output,bkg,last1);
+}
+
+/* the text of this stage and the ones after it */
+
+char *pstext(struct pstage *ps)
+{
+struct arena *a;
+wordcode *pc = ps->pc;
+char *s;
+
+	if (!ps->prog)
+		return getptext(ps->pl);
+	a = newarena();
+	s = getptext(decpline(ps->prog,&pc,a));
+	freearena(a);
+	return s;
+}
+
+/* run a command.  Simple commands are copied straight out of the
+	code; compound commands are run from their trees. */
+
+void execwcomm(struct prog *p,wordcode *pc,int input,int output,int bkg,
+	int last1)
+{
+	if (wc_type(*pc) == SIMPLE)
+		runcomm(wcomm(p,pc),input,output,bkg,last1);
+	else
+		execcomm(wtree(p,pc),input,output,bkg,last1);
+}
+
+/* make a copy of a simple command, ready to be expanded */
+
+comm wcomm(struct prog *p,wordcode *pc)
+{
+comm c = alloc(sizeof(struct cnode));
+struct fnode *f;
+int ct;
+
+	c->type = wc_type(*pc);
+	c->flags = wc_flags(*pc);
+	pc += 3;
+	c->cmd = (*pc == WC_NONE) ? NULL : strdup(p->strs+*pc);
+	pc++;
+	c->args = newtable();
+	for (ct = *pc++; ct; ct--)
+		addnode(c->args,strdup(p->strs+*pc++));
+	c->redir = newtable();
+	for (ct = *pc++; ct; ct--)
+		{
+		f = alloc(sizeof(struct fnode));
+		f->type = *pc++;
+		f->fd1 = *pc++;
+		if (f->type < HEREDOC || f->type == INPIPE || f->type == OUTPIPE)
+			f->u.name = strdup(p->strs+*pc++);
+		else
+			f->u.fd2 = *pc++;
+		addnode(c->redir,f);
+		}
+	if (*pc != WC_NONE)
+		{
+		c->vars = newtable();
+		for (ct = *pc++; ct; ct--)
+			addnode(c->vars,strdup(p->strs+*pc++));
+		}
+	return c;
+}
+
+/* get the tree of a compound command, decoding it if need be */
+
+comm wtree(struct prog *p,wordcode *pc)
+{
+	if (!p->trees[pc[2]])
+		deccomm(p,pc,p->arena);
+	return p->trees[pc[2]];
+}
+
+/* decode a list into a tree allocated from a.  The lists of the
+	tree point back at their code, and compound commands decoded
+	into p->arena are kept in p->trees. */
+
+list declist(struct prog *p,wordcode *pc,struct arena *a)
+{
+list l,first = NULL,last = NULL;
+wordcode w;
+
+	do
+		{
+		l = aralloc(a,sizeof(struct lnode));
+		l->prog = p;
+		l->pc = pc-p->code;
+		w = *pc++;
+		l->type = wc_type(w);
+		l->lineno = wc_flags(w) >> 1;
+		l->left = decsublist(p,&pc,a);
+		if (last)
+			last->right = l;
+		else
+			first = l;
+		last = l;
+		}
+	while (!(wc_flags(w) & 1));
+	return first;
+}
+
+/* decode a list prefixed by its length, and skip over it */
+
+list declistlen(struct prog *p,wordcode **pcp,struct arena *a)
+{
+wordcode *pc = *pcp;
+
+	*pcp += *pc+1;
+	return (*pc) ? declist(p,pc+1,a) : NULL;
+}
+
+list2 decsublist(struct prog *p,wordcode **pcp,struct arena *a)
+{
+list2 l = aralloc(a,sizeof(struct l2node));
+wordcode *pc = *pcp,*q = pc+2;
+
+	l->type = wc_type(*pc);
+	l->flags = wc_flags(*pc);
+	l->left = decpline(p,&q,a);
+	*pcp += pc[1];
+	if (l->type != END)
+		l->right = decsublist(p,pcp,a);
+	return l;
+}
+
+pline decpline(struct prog *p,wordcode **pcp,struct arena *a)
+{
+pline pl = aralloc(a,sizeof(struct pnode));
+wordcode *pc = *pcp;
+
+	pl->type = wc_type(*pc);
+	pl->left = deccomm(p,pc+1,a);
+	*pcp = pc+1+pc[2];
+	if (pl->type != END)
+		pl->right = decpline(p,pcp,a);
+	return pl;
+}
+
+comm deccomm(struct prog *p,wordcode *pc,struct arena *a)
+{
+comm c;
+struct fnode *f;
+int ct;
+
+	if (wc_type(*pc) != SIMPLE && p->trees[pc[2]])
+		return p->trees[pc[2]];
+	c = aralloc(a,sizeof(struct cnode));
+	c->type = wc_type(*pc);
+	c->flags = wc_flags(*pc);
+	if (c->type != SIMPLE && a == p->arena)
+		p->trees[pc[2]] = c;
+	pc += 3;
+	c->cmd = (*pc == WC_NONE) ? NULL : p->strs+*pc;
+	pc++;
+	c->args = dectable(p,&pc,a);
+	c->redir = arnewtable(a);
+	for (ct = *pc++; ct; ct--)
+		{
+		f = aralloc(a,sizeof(struct fnode));
+		f->type = *pc++;
+		f->fd1 = *pc++;
+		if (f->type < HEREDOC || f->type == INPIPE || f->type == OUTPIPE)
+			f->u.name = p->strs+*pc++;
+		else
+			f->u.fd2 = *pc++;
+		araddnode(a,c->redir,f);
+		}
+	if (*pc != WC_NONE)
+		c->vars = dectable(p,&pc,a);
+	else
+		pc++;
+	switch (c->type)
+		{
+		case SUBSH:
+		case CURSH:
+			c->left = declistlen(p,&pc,a);
+			break;
+		case CFOR:
+		case CSELECT:
+			{
+			struct fornode *fn = aralloc(a,sizeof(struct fornode));
+
+			fn->name = p->strs+*pc++;
+			fn->inflag = *pc++;
+			fn->par = *pc++;
+			fn->grpout = *pc++;
+			fn->list = declistlen(p,&pc,a);
+			c->info = fn;
+			break;
+			}
+		case CWHILE:
+			{
+			struct whilenode *w = aralloc(a,sizeof(struct whilenode));
+
+			w->cond = *pc++;
+			w->cont = declistlen(p,&pc,a);
+			w->loop = declistlen(p,&pc,a);
+			c->info = w;
+			break;
+			}
+		case CREPEAT:
+			{
+			struct repeatnode *r = aralloc(a,sizeof(struct repeatnode));
+
+			r->count = *pc++;
+			r->list = declistlen(p,&pc,a);
+			c->info = r;
+			break;
+			}
+		case CIF:
+			{
+			struct ifnode *i,**ip = (struct ifnode **) &c->info;
+
+			for (ct = *pc++; ct; ct--)
+				{
+				*ip = i = aralloc(a,sizeof(struct ifnode));
+				i->ifl = declistlen(p,&pc,a);
+				i->thenl = declistlen(p,&pc,a);
+				ip = &i->next;
+				}
+			break;
+			}
+		case CCASE:
+			{
+			struct casenode *cn,**cp = (struct casenode **) &c->info;
+
+			for (ct = *pc++; ct; ct--)
+				{
+				*cp = cn = aralloc(a,sizeof(struct casenode));
+				cn->pat = p->strs+*pc++;
+				cn->list = declistlen(p,&pc,a);
+				cp = &cn->next;
+				}
+			break;
+			}
+		}
+	return c;
+}
+
+table dectable(struct prog *p,wordcode **pcp,struct arena *a)
+{
+table t = arnewtable(a);
+wordcode *pc = *pcp;
+int ct;
+
+	for (ct = *pc++; ct; ct--)
+		araddnode(a,t,p->strs+*pc++);
+	*pcp = pc;
+	return t;
+}
+
+/* get the text of a list of which only the code is left */
+
+char *getwltext(list l)
+{
+struct arena *a = newarena();
+char *s;
+
+	s = getltext(declist(l->prog,l->prog->code+l->pc,a));
+	freearena(a);
+	return s;
+}
+
+/* compile a file into file.zwc; the file is parsed, not executed.
+	It is written under another name and renamed, so that a shell
+	that has the old one mapped keeps it intact. */
+
+int compfile(char *s)
+{
+char buf[MAXPATHLEN],tmp[MAXPATHLEN];
+struct zwchdr h;
+struct stat st;
+struct arena *ar,*oar = parena;
+list l;
+int fd = SHIN,iact = opts[INTERACTIVE],ret = 0,olineno = lineno;
+struct inbuf *obshin = bshin;
+
+	sprintf(buf,"%s.zwc",s);
+	sprintf(tmp,"%s.%d",buf,getpid());
+	if ((SHIN = movefd(open(s,O_RDONLY))) == -1)
+		{
+		SHIN = fd;
+		zerrnam("zcompile","%e: %s",errno,s);
+		return 1;
+		}
+	if (!(zwcout = fopen(tmp,"w")))
+		{
+		zerrnam("zcompile","%e: %s",errno,tmp);
+		close(SHIN);
+		SHIN = fd;
+		return 1;
+		}
+	fstat(SHIN,&st);
+	h.magic = ZWC_MAGIC;
+	h.version = ZWC_VERSION;
+	h.mtime = st.st_mtime;
+	h.size = st.st_size;
+	fwrite(&h,sizeof h,1,zwcout);
+	bshin = inopen(SHIN);
+	opts[INTERACTIVE] = OPT_UNSET;
+	lineno = 0;
+	FOREVER
+		{
+		peek = EMPTY;
+		hbegin();
+		ainit();
+		parena = ar = newarena();
+		l = parlist1(0);
+		parena = oar;
+		hend();
+		if (errflag || (peek != EMPTY && peek != EOF && (l || peek != NEWLIN)))
+			{
+			if (!errflag)
+				zerrnam("zcompile","parse error: %s",s);
+			ret = 1;
+			}
+		else if (l)
+			ret = putzwc(ZWC_LIST,0,NULL,compile(l,ar));
+		freearena(ar);
+		if (ret || peek == EOF)
+			break;
+		}
+	inclose(bshin);
+	if ((fclose(zwcout) == EOF || (!ret && rename(tmp,buf))) && !ret)
+		{
+		zerrnam("zcompile","%e: %s",errno,buf);
+		ret = 1;
+		}
+	zwcout = NULL;
+	if (ret)
+		unlink(tmp);
+	opts[INTERACTIVE] = iact;
+	lineno = olineno;
+	bshin = obshin;
+	SHIN = fd;
+	peek = EMPTY;
+	errflag = 0;
+	return ret;
+}
+
+/* write a record to the compiled file */
+
+int putzwc(int type,int flags,char *nam,struct prog *p)
+{
+static char pad[sizeof(wordcode)];
+struct zwcrec r;
+
+	if (p->heredocs)
+		{
+		zerrnam("zcompile","can't compile here documents");
+		errflag = 1;
+		return 1;
+		}
+	r.type = type;
+	r.flags = flags;
+	r.len = p->len;
+	r.slen = p->slen;
+	r.ntrees = p->ntrees;
+	r.nlen = (nam) ? strlen(nam)+1 : 0;
+	r.sum = zwcsum(zwcsum(zwcsum(zwcsum(0,(char *) &r,
+		(char *) &r.sum-(char *) &r),nam,r.nlen),(char *) p->code,
+		r.len*sizeof(wordcode)),p->strs,r.slen);
+	fwrite(&r,sizeof r,1,zwcout);
+	fwrite(nam,1,r.nlen,zwcout);
+	fwrite(pad,1,ZWCPAD(r.nlen)-r.nlen,zwcout);
+	fwrite(p->code,sizeof(wordcode),r.len,zwcout);
+	fwrite(p->strs,1,r.slen,zwcout);
+	fwrite(pad,1,ZWCPAD(r.slen)-r.slen,zwcout);
+	return 0;
+}
+
+/* add n bytes at s to the checksum of a record, which covers the
+	record before its sum and everything after it */
+
+wordcode zwcsum(wordcode sum,char *s,long n)
+{
+	while (n--)
+		sum = sum*31+(unsigned char) *s++;
+	return sum;
+}
+
+/* map file.zwc if it is up to date with file */
+
+struct zwcfile *openzwc(char *s)
+{
+char buf[MAXPATHLEN],*m;
+struct stat st,zst;
+struct zwchdr *h;
+struct zwcfile *z;
+int fd;
+
+	sprintf(buf,"%s.zwc",s);
+	if (stat(s,&st) == -1 || (fd = open(buf,O_RDONLY)) == -1)
+		return NULL;
+	if (fstat(fd,&zst) == -1 || zst.st_size < sizeof *h ||
+			(m = mmap(NULL,zst.st_size,PROT_READ,MAP_PRIVATE,
+			fd,0)) == (char *) MAP_FAILED)
+		{
+		close(fd);
+		return NULL;
+		}
+	close(fd);
+	h = (struct zwchdr *) m;
+	if (h->magic != ZWC_MAGIC || h->version != ZWC_VERSION ||
+			h->mtime != st.st_mtime || h->size != st.st_size)
+		{
+		munmap(m,zst.st_size);
+		return NULL;
+		}
+	z = alloc(sizeof *z);
+	z->base = m;
+	z->ptr = m+sizeof *h;
+	z->end = m+zst.st_size;
+	return z;
+}
+
+void closezwc(struct zwcfile *z)
+{
+	munmap(z->base,z->end-z->base);
+	free(z);
+}
+
+/* get the next list from the compiled file being sourced, defining
+	the functions that come before it.  The list runs from the mapped
+	code; function bodies are copied, since they outlive the file. */
+
+list zwcnext(struct arena *a)
+{
+struct zwcrec *r;
+struct arena *fa;
+list l;
+char *nam,*next;
+
+	for (;;)
+		{
+		if (zwcin->ptr == zwcin->end)
+			{
+			peek = EOF;
+			return NULL;
+			}
+		r = (struct zwcrec *) zwcin->ptr;
+		nam = (char *) (r+1);
+		if (!(next = zwccheck(r,zwcin->end)))
+			{
+			zerr("corrupt compiled file");
+			errflag = 1;
+			zwcin->ptr = zwcin->end;
+			peek = EOF;
+			return NULL;
+			}
+		zwcin->ptr = next;
+		if (r->type == ZWC_LIST)
+			{
+			l = aralloc(a,sizeof(struct lnode));
+			l->prog = zwcprog(r,a,0);
+			return l;
+			}
+		fa = newarena();
+		l = aralloc(fa,sizeof(struct lnode));
+		l->arena = fa;
+		l->prog = zwcprog(r,fa,1);
+		deffunc(strdup(nam),l,r->flags);
+		}
+}
+
+/* check that a record of a compiled file is all there and well
+	formed, so that it can be decoded and run without further checks.
+	Returns the record after it, or NULL if it is corrupt. */
+
+char *zwccheck(struct zwcrec *r,char *end)
+{
+struct prog p;
+char *nam = (char *) (r+1);
+long avail = end-nam;
+
+	if (end-(char *) r < (long) sizeof *r || r->nlen < 0 || r->len <= 0 ||
+			r->slen < 0 || r->ntrees < 0 || r->ntrees > r->len ||
+			(r->type != ZWC_LIST && r->type != ZWC_FUNC) ||
+			r->nlen > avail || r->len > avail/sizeof(wordcode) ||
+			r->slen > avail || ZWCPAD(r->nlen)+r->len*sizeof(wordcode)+
+			ZWCPAD(r->slen) > avail)
+		return NULL;
+	if (r->type == ZWC_FUNC && (!r->nlen || nam[r->nlen-1]))
+		return NULL;
+	p.code = (wordcode *) (nam+ZWCPAD(r->nlen));
+	p.strs = (char *) (p.code+r->len);
+	p.len = r->len;
+	p.slen = r->slen;
+	p.ntrees = r->ntrees;
+	if (zwcsum(zwcsum(zwcsum(zwcsum(0,(char *) r,
+			(char *) &r->sum-(char *) r),nam,r->nlen),(char *) p.code,
+			p.len*sizeof(wordcode)),p.strs,p.slen) != r->sum ||
+			(p.slen && p.strs[p.slen-1]) || zwclist(&p,0) != p.len)
+		return NULL;
+	return p.strs+ZWCPAD(r->slen);
+}
+
+/* check the list at pc in the code of a record, as declist() would
+	decode it.  These return where what they check ends, or -1 if it
+	is corrupt. */
+
+int zwclist(struct prog *p,int pc)
+{
+wordcode w;
+
+	do
+		{
+		if (pc >= p->len || wc_code(w = p->code[pc++]) != WC_LIST ||
+				wc_type(w) > ASYNC || (pc = zwcsublist(p,pc)) == -1)
+			return -1;
+		}
+	while (!(wc_flags(w) & 1));
+	return pc;
+}
+
+int zwclistlen(struct prog *p,int pc)
+{
+wordcode l;
+
+	if (pc >= p->len || (l = p->code[pc++]) > p->len-pc)
+		return -1;
+	return (!l || zwclist(p,pc) == pc+l) ? pc+l : -1;
+}
+
+int zwcsublist(struct prog *p,int pc)
+{
+wordcode w;
+int end,t;
+
+	do
+		{
+		if (pc+2 > p->len || wc_code(w = p->code[pc]) != WC_SUBLIST ||
+				((t = wc_type(w)) != END && t != ORNEXT && t != ANDNEXT) ||
+				p->code[pc+1] > p->len-pc)
+			return -1;
+		end = pc+p->code[pc+1];
+		if ((pc = zwcpline(p,pc+2)) != end)
+			return -1;
+		}
+	while (t != END);
+	return pc;
+}
+
+int zwcpline(struct prog *p,int pc)
+{
+wordcode w;
+
+	do
+		if (pc >= p->len || wc_code(w = p->code[pc++]) != WC_PIPE ||
+				wc_type(w) > PIPE || (pc = zwccomm(p,pc)) == -1)
+			return -1;
+	while (wc_type(w) != END);
+	return pc;
+}
+
+/* != 0 if w is the start of a string of a record, or WC_NONE if
+	none is allowed */
+
+int zwcstr(struct prog *p,wordcode w,int none)
+{
+	return (none && w == WC_NONE) || (w < p->slen && (!w || !p->strs[w-1]));
+}
+
+/* != 0 if w is a word; the parser makes no empty words, but for the
+	command name of a line that only sets variables */
+
+int zwcword(struct prog *p,wordcode w)
+{
+	return zwcstr(p,w,0) && p->strs[w];
+}
+
+/* a table of words, or of name/value pairs for the vars of a
+	command, whose values may be empty */
+
+int zwctable(struct prog *p,int pc,int vars)
+{
+wordcode ct,i;
+
+	if (pc >= p->len || (ct = p->code[pc++]) > p->len-pc || (vars && ct%2))
+		return -1;
+	for (i = 0; i != ct; i++,pc++)
+		if (!((vars && i%2) ? zwcstr(p,p->code[pc],0) :
+				zwcword(p,p->code[pc])))
+			return -1;
+	return pc;
+}
+
+int zwccomm(struct prog *p,int pc)
+{
+int n = pc,t;
+wordcode w,ct;
+
+	if (pc+4 > p->len || wc_code(w = p->code[pc]) != WC_CMD ||
+			(t = wc_type(w)) > CSELECT || t == SHFUNC ||
+			p->code[pc+1] > p->len-pc ||
+			(t != SIMPLE && p->code[pc+2] >= p->ntrees) ||
+			!zwcstr(p,p->code[pc+3],1) || (pc = zwctable(p,pc+4,0)) == -1 ||
+			pc >= p->len)
+		return -1;
+	for (ct = p->code[pc++]; ct; ct--,pc += 3)
+		{
+		if (pc+3 > p->len || (w = p->code[pc]) >= NONE || w == HEREDOC ||
+				p->code[pc+1] > 9)
+			return -1;
+		if ((w < HEREDOC || w == INPIPE || w == OUTPIPE) &&
+				!zwcword(p,p->code[pc+2]))
+			return -1;
+		}
+	if (pc >= p->len)
+		return -1;
+	if (p->code[pc] == WC_NONE)
+		pc++;
+	else if ((pc = zwctable(p,pc,1)) == -1)
+		return -1;
+	switch (t)
+		{
+		case SUBSH:
+		case CURSH:
+			pc = zwclistlen(p,pc);
+			break;
+		case CFOR:
+		case CSELECT:
+			if (pc+4 > p->len || !zwcword(p,p->code[pc]))
+				return -1;
+			pc = zwclistlen(p,pc+4);
+			break;
+		case CWHILE:
+			if (pc+1 > p->len || (pc = zwclistlen(p,pc+1)) == -1)
+				return -1;
+			pc = zwclistlen(p,pc);
+			break;
+		case CREPEAT:
+			if (pc+1 > p->len)
+				return -1;
+			pc = zwclistlen(p,pc+1);
+			break;
+		case CIF:
+			if (pc >= p->len)
+				return -1;
+			for (ct = p->code[pc++]; ct && pc != -1; ct--)
+				if ((pc = zwclistlen(p,pc)) != -1)
+					pc = zwclistlen(p,pc);
+			break;
+		case CCASE:
+			if (pc >= p->len)
+				return -1;
+			for (ct = p->code[pc++]; ct && pc != -1; ct--)
+				pc = (pc < p->len && zwcword(p,p->code[pc])) ?
+					zwclistlen(p,pc+1) : -1;
+			break;
+		}
+	return (pc == n+p->code[n+1]) ? pc : -1;
+}
+
+/* make a program out of a record, copying it into a if asked to */
+
+struct prog *zwcprog(struct zwcrec *r,struct arena *a,int copy)
+{
+struct prog *p = aralloc(a,sizeof(struct prog));
+
+	p->code = (wordcode *) ((char *) (r+1)+ZWCPAD(r->nlen));
+	p->strs = (char *) (p->code+r->len);
+	if (copy)
+		{
+		p->code = memcpy(aralloc(a,r->len*sizeof(wordcode)),p->code,
+			r->len*sizeof(wordcode));
+		p->strs = memcpy(aralloc(a,r->slen),p->strs,r->slen);
+		}
+	p->trees = aralloc(a,r->ntrees*sizeof(comm));
+	p->len = r->len;
+	p->slen = r->slen;
+	p->ntrees = r->ntrees;
+	p->arena = a;
+	return p;
+}
@@ -0,0 +1,43 @@
+struct prog *compile(list l,struct arena *a);
+void wcadd(struct wcbuf *b,wordcode w);
+wordcode wcstr(struct wcbuf *b,char *s);
+void complist(struct wcbuf *b,list l,struct prog *p);
+void complistlen(struct wcbuf *b,list l,struct prog *p);
+void compsublist(struct wcbuf *b,list2 l,struct prog *p);
+void compcomm(struct wcbuf *b,comm c,struct prog *p);
+void comptable(struct wcbuf *b,table t);
+int wclength(table t);
+void execwlist(struct prog *p,wordcode *pc);
+void execwlist2(struct prog *p,wordcode *pc,int type,int last1);
+int execwpline(struct prog *p,wordcode *pc,int how,int last1);
+int pslast(struct pstage *ps);
+int pstype(struct pstage *ps);
+void psnext(struct pstage *ps,struct pstage *next);
+void psrun(struct pstage *ps,int input,int output,int bkg,int last1);
+char *pstext(struct pstage *ps);
+void execwcomm(struct prog *p,wordcode *pc,int input,int output,int bkg,int last1);
+comm wcomm(struct prog *p,wordcode *pc);
+comm wtree(struct prog *p,wordcode *pc);
+list declist(struct prog *p,wordcode *pc,struct arena *a);
+list declistlen(struct prog *p,wordcode **pcp,struct arena *a);
+list2 decsublist(struct prog *p,wordcode **pcp,struct arena *a);
+pline decpline(struct prog *p,wordcode **pcp,struct arena *a);
+comm deccomm(struct prog *p,wordcode *pc,struct arena *a);
+table dectable(struct prog *p,wordcode **pcp,struct arena *a);
+char *getwltext(list l);
+int compfile(char *s);
+int putzwc(int type,int flags,char *nam,struct prog *p);
+wordcode zwcsum(wordcode sum,char *s,long n);
+struct zwcfile *openzwc(char *s);
+void closezwc(struct zwcfile *z);
+list zwcnext(struct arena *a);
+char *zwccheck(struct zwcrec *r,char *end);
+int zwclist(struct prog *p,int pc);
+int zwclistlen(struct prog *p,int pc);
+int zwcsublist(struct prog *p,int pc);
+int zwcpline(struct prog *p,int pc);
+int zwcstr(struct prog *p,wordcode w,int none);
+int zwcword(struct prog *p,wordcode w);
+int zwctable(struct prog *p,int pc,int vars);
+int zwccomm(struct prog *p,int pc);
+struct prog *zwcprog(struct zwcrec *r,struct arena *a,int copy);
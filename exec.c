@@ -34,8 +34,10 @@
 #include <sys/errno.h>
 #include <sys/dir.h>
 
-#define execerr() { if (forked) exit(1); freecmd(comm); \
-	closemnodes(mfds); errflag = 1; return; }
+#define execerr() { if (forked) exit(1); closemnodes(mfds); \
+	fixfds(save); freecopy(comm); if (spath) free(spath); \
+	if (trace) traceend(trace,tstart,getpid(),1); \
+	if (vspawn) lastval = 1; else errflag = 1; return; }
 #define magicerr() { if (magic) putc('\n',stderr); errflag = 1; }
 
 /* execute a string */
@@ -43,11 +45,13 @@
 void execstring(char *s)
 {
 list l;
+struct arena *ar;
 
-	hungets(strdup("\n"));
+	hungets("\n");
 	hungets(s);
+	free(s);
 	strinbeg();
-	if (!(l = parlist(1)))
+	if (!(l = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -55,27 +59,36 @@ list l;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return;
 		}
 	strinend();
 	execlist(l);
+	freearena(ar);
 }
 
-/* duplicate a list and run it */
+/* run a shell function body in place */
 
 void newrunlist(list l)
 {
-list a = duplist(l); runlist(a);
+int cj = curjob;
+
+	l->refs++;
+	execlist(l);
+	curjob = cj;
+	unreflist(l);
 }
 
 /* fork and set limits */
 
 int phork(void)
 {
-int pid = fork(),t0;
+int pid,t0;
 
+	pathcheck = 0;
+	pid = fork();
 	if (pid == -1)
 		{
 		zerr("fork failed: %e",errno);
@@ -91,140 +104,147 @@ int pid = fork(),t0;
 
 void execcursh(comm comm)
 {
-	runlist(comm->left);
-	comm->left = NULL;
+int cj = curjob;
+
+	execlist(comm->left);
+	curjob = cj;
 }
 
-/* execve an external command */
+/* execve an external command.  pnam is its path, looked up by
+	execpath() in the parent; if the command had its own assignments
+	(which might change PATH) it is looked up here instead. */
 
-void execute(char *arg0,table args)
+void execute(char *arg0,char *pnam,table args)
 {
 char **argv;
-char *z,*s,buf[MAXPATHLEN],buf2[MAXPATHLEN];
-struct chnode *cn;
-int t0,tl,ee = 0;
-
-#define zexecve(X,Y,Z) {execve(z=(X),Y,Z);\
-	if(errno!=ENOENT){ee = errno;strcpy(buf2,buf);}}
+char *z,*s;
 
-	cn = gethnode(arg0,chtab);
 	if (s = getenv("STTY"))
 		zyztem("stty",s);
+	if (!pnam && !(pnam = execpath(arg0)))
+		{
+		zerr("command not found: %s",arg0);
+		_exit(1);
+		}
 	if (z = getenv("ARGV0"))
 		z = strdup(z);
 	else
 		z = arg0;
 	argv = makecline(z,args);
 	fixsigs();
-	if (cn)
-		{
-		if (cn->type == EXCMD_POSTDOT)
-			{zexecve(arg0,argv,environ);}
-		{zexecve(cn->u.nam,argv,environ);}
-		}
+	execve(pnam,argv,environ);
+	zerr("%e: %s",errno,pnam);
+	_exit(1);
+}
+
+/* get the pathname to execute for a command, through the command
+	hash table.  A command that isn't in it (say, in a directory that
+	can't be read) but is found by searching the path is added to
+	the table, and one not found at all goes in nocmdtab (unless .
+	is in the path), so the path is only searched once for it until
+	a path directory changes.  A file that is there but can't be
+	executed is returned anyway, so that execve says why.  This is
+	the only place that fills nocmdtab; findcmd() comes through here. */
+
+char *execpath(char *arg0)
+{
+char *s,*ee = NULL,buf[MAXPATHLEN];
+struct chnode *cn;
+int t0,dot = 0;
+
 	for (s = arg0; *s; s++)
 		if (*s == '/')
+			return strdup(arg0);
+	if ((cn = hashcmd(arg0)) && cn->type != BUILTIN)
+		{
+		if (cn->type == EXCMD_POSTDOT && !access(arg0,X_OK))
+			return tricat("./",arg0,"");
+		if (!access(cn->u.nam,X_OK))
+			return strdup(cn->u.nam);
+		}
+	if (gethnode(arg0,nocmdtab))
+		return NULL;
+	for (t0 = 0; t0 != pathct; t0++)
+		{
+		if (!strcmp(path[t0],"."))
+			dot = 1;
+		if (strlen(path[t0])+strlen(arg0)+2 > MAXPATHLEN)
+			continue;
+		sprintf(buf,"%s/%s",path[t0],arg0);
+		if (!access(buf,X_OK))
 			{
-			execve(arg0,argv,environ);
-			zerr("%e: %s",errno,arg0);
-			_exit(1);
-			}
-	for (t0 = pathct; t0; t0--,path++)
-		if (**path == '.')
-			{zexecve(arg0,argv,environ);}
-		else
-			{
-			tl = strlen(*path);
-			strcpy(buf,*path);
-			buf[tl] = '/';
-			if (strlen(arg0)+strlen(buf)+1 >= MAXPATHLEN)
+			if (!strcmp(path[t0],".") || (cn && cn->type == BUILTIN))
+				;
+			else if (cn)
+				{
+				free(cn->u.nam);
+				cn->u.nam = strdup(buf);
+				}
+			else
 				{
-				zerr("command too long: %s",arg0);
-				_exit(1);
+				cn = alloc(sizeof(struct chnode));
+				cn->type = EXCMD_PREDOT;
+				cn->globstat = GLOB;
+				cn->u.nam = strdup(buf);
+				addhnode(strdup(arg0),cn,chtab,freechnode);
 				}
-			strcpy(buf+tl+1,arg0);
-			{zexecve(buf,argv,environ);}
+			if (ee)
+				free(ee);
+			return strdup(buf);
 			}
-	if (ee)
-		{
-		z = buf2;
-		errno = ee;
-		goto errs;
+		if (errno != ENOENT && !ee)
+			ee = strdup(buf);
 		}
-	zerr("command not found: %s",arg0);
-	_exit(1);
-errs:
-	zerr("%e: %s",errno,z);
-	_exit(1);
+	if (!ee && !dot)
+		addhnode(strdup(arg0),strdup(arg0),nocmdtab,freestr);
+	return ee;
 }
 
-#define try(X) { if (!access(X,X_OK)) return strdup(X); }
-
-/* get the pathname of a command */
+/* get the pathname of a command, as execpath() finds it, if it can
+	be executed */
 
 char *findcmd(char *arg0)
 {
-char *s,buf[MAXPATHLEN];
-int t0,tl;
-struct chnode *cn = gethnode(arg0,chtab);
-char **pp = path;
+char *s = execpath(arg0);
 
-	if (cn)
+	if (s && access(s,X_OK))
 		{
-		if (cn->type == EXCMD_POSTDOT)
-			{
-			strcpy(buf,"./");
-			strcat(buf,arg0);
-			try(buf);
-			}
-		try(cn->u.nam);
+		free(s);
+		return NULL;
 		}
-	for (s = arg0; *s; s++)
-		if (*s == '/')
-			{
-			try(arg0);
-			goto failed;
-			}
-	for (t0 = pathct; t0; t0--,pp++)
-		if (**pp == '.')
-			{
-			strcpy(buf,"./");
-			strcat(buf,arg0);
-			try(buf);
-			}
-		else
-			{
-			tl = strlen(*pp);
-			strcpy(buf,*pp);
-			buf[tl] = '/';
-			strcpy(buf+tl+1,arg0);
-			try(buf);
-			}
-failed:
-	return NULL;
+	return s;
 }
 
+/* run a list.  Nothing below here modifies the parse tree, so
+	loop and function bodies can be run over and over. */
+
 void execlist(list list)
 {
-	execlist1(list);
-	freelist(list);
-}
+int prof;
+struct profframe pf;
 
-void execlist1(list list)
-{
+	if (list->prog)
+		{
+		execwlist(list->prog,list->prog->code+list->pc);
+		return;
+		}
 	if (breaks)
 		return;
 	switch(list->type)
 		{
 		case SYNC:
 		case ASYNC:
+			if (prof = isset(PROFILE))
+				profenter(&pf,1);
 			execlist2(list->left,list->type,!list->right);
+			if (prof)
+				proflist(&pf,list->lineno);
 			if (sigtrapped[SIGDEBUG])
 				dotrap(SIGDEBUG);
 			if (sigtrapped[SIGERR] && lastval)
 				dotrap(SIGERR);
 			if (list->right && !retflag)
-				execlist1(list->right);
+				execlist(list->right);
 			break;
 		}
 }
@@ -249,12 +269,25 @@ void execlist2(list2 list,int type,int last1)
 
 int execpline(list2 l,int how,int last1)
 {
+struct pstage ps;
+
+	ps.pl = l->left;
+	ps.prog = NULL;
+	return runpline(&ps,l->flags,how,last1);
+}
+
+/* run a pipeline as a job; the tree and compiled forms both come
+	through here */
+
+int runpline(struct pstage *ps,int flags,int how,int last1)
+{
 int ipipe[2] = {0,0},opipe[2] = {0,0};
 
+	handlesigs();
 	sigblock(sigmask(SIGCHLD));
 	curjob = getfreejob(); 
-	initjob(l->flags);
-	if (l->flags & PFLAG_COPROC)
+	initjob(flags);
+	if (flags & PFLAG_COPROC)
 		{
 		how = ASYNC;
 		mpipe(ipipe);
@@ -267,7 +300,7 @@ int ipipe[2] = {0,0},opipe[2] = {0,0};
 		spin = ipipe[0];
 		spout = opipe[1];
 		}
-	execpline2(l->left,how,opipe[0],ipipe[1],last1);
+	execpline2(ps,how,opipe[0],ipipe[1],last1);
 	if (how == ASYNC)
 		{
 		spawnjob();
@@ -278,42 +311,41 @@ int ipipe[2] = {0,0},opipe[2] = {0,0};
 		{
 		waitjobs();
 		sigsetmask(0);
-		if (l->flags & PFLAG_NOT)
+		if (flags & PFLAG_NOT)
 			lastval = !lastval;
 		return !lastval;
 		}
 }
 
-void execpline2(pline pline,int how,int input,int output,int last1)
+void execpline2(struct pstage *ps,int how,int input,int output,int last1)
 {
 int pid;
 int pipes[2];
+struct pstage right;
 
 	if (breaks)
 		return;
-	if (!pline)
+	if (!ps->pl && !ps->prog)
 		return;
-	if (pline->type == END)
-		{
-		execcomm(pline->left,input,output,how==ASYNC,last1);
-		pline->left = NULL;
-		}
+	if (pslast(ps))
+		psrun(ps,input,output,how==ASYNC,last1);
 	else
 		{
+		psnext(ps,&right);
 		mpipe(pipes);
 
 		/* if we are doing "foo | bar" where foo is a current
 			shell command, do foo in the current shell and do
 			the rest of the pipeline in a subshell. */
 
-		if (pline->left->type >= CURSH && how == SYNC)
+		if (pstype(ps) >= CURSH && how == SYNC)
 			{
 			if (!(pid = fork()))
 				{
 				close(pipes[1]);
-				entersubsh(1);
+				entersubsh(1,0);
 				exiting = 1;
-				execpline2(pline->right,ASYNC,pipes[0],output,1);
+				execpline2(&right,ASYNC,pipes[0],output,1);
 				_exit(lastval);
 				}
 			else if (pid == -1)
@@ -326,25 +358,24 @@ int pipes[2];
 				char *s,*text;
 
 				close(pipes[0]);
-				text = s = getptext(pline->right);
+				text = s = pstext(&right);
 				for (;*s;s++)
 				if (*s == '\n')
 					*s = ';';
 				untokenize(text);
 				addproc(pid,text)->lastfg = 1;
-				freepline(pline->right);
-				pline->right = NULL;
+				right.pl = NULL;
+				right.prog = NULL;
 				}
 			}
 
 		/* otherwise just do the pipeline normally. */
 
-		execcomm(pline->left,input,pipes[1],how==ASYNC,0);
-		pline->left = NULL;
+		psrun(ps,input,pipes[1],how==ASYNC,0);
 		close(pipes[1]);
-		if (pline->right)
+		if (right.pl || right.prog)
 			{
-			execpline2(pline->right,how,pipes[0],output,last1);
+			execpline2(&right,how,pipes[0],output,last1);
 			close(pipes[0]);
 			}
 		}
@@ -529,7 +560,17 @@ int pipes[2];
 		}
 }
 
-void execcomm(comm comm,int input,int output,int bkg,int last1)
+/* execute a command.  The words are expanded in a copy, so the
+	parse tree passed in is left as it was. */
+
+void execcomm(comm xcomm,int input,int output,int bkg,int last1)
+{
+	runcomm(copycomm(xcomm),input,output,bkg,last1);
+}
+
+/* execute a copy of a command, freeing it when done */
+
+void runcomm(comm comm,int input,int output,int bkg,int last1)
 {
 int type;
 long pid = 0;
@@ -537,15 +578,20 @@ table args = comm->args;
 int save[10] = {0,0,0,0,0,0,0,0,0,0},gstat;
 struct fnode *fn;
 struct mnode *mfds[10] = {0,0,0,0,0,0,0,0,0,0};
-int fil,forked = 0,iscursh = 0,t0;
+int fil,forked = 0,iscursh = 0,vspawn = 0,t0;
 struct chnode *chn = NULL;
-char *text;
+char *text,*spath = NULL,*trace = NULL;
+char traceid[TRACEIDLEN],tracesave[TRACEIDLEN];
+double tstart;
+struct procnode *pn;
 list l;
 
 	if ((type = comm->type) == SIMPLE && !*comm->cmd)
 		{
 		if (comm->vars)
 			addvars(comm->vars);
+		comm->vars = NULL;
+		freecopy(comm);
 		return;
 		}
 	if (comm->cmd)
@@ -555,6 +601,7 @@ list l;
 			if (full(args))
 				{
 				zerrnam(comm->cmd,"too many arguments");
+				freecopy(comm);
 				return;
 				}
 			addnode(args,comm->cmd);
@@ -564,7 +611,7 @@ list l;
 		docmdsubs(&comm->cmd);
 		if (errflag)
 			{
-			freecmd(comm);
+			freecopy(comm);
 			lastval = 1;
 			return;
 			}
@@ -591,11 +638,12 @@ list l;
 			{
 			insnode(comm->args,(Node) comm->args,comm->cmd);
 			comm->cmd = NULL;
-			comm->left = duplist(l);
+			comm->left = l;
+			l->refs++;
 			type = comm->type = SHFUNC;
 			}
 		else
-			chn = gethnode(comm->cmd,chtab);
+			chn = hashcmd(comm->cmd);
 		}
 	if (unset(RMSTARSILENT) && jobbing && chn && chn->type != BUILTIN &&
 			!strcmp(comm->cmd,"rm") && full(comm->args) &&
@@ -604,7 +652,7 @@ list l;
 		checkrmall();
 	if (errflag)
 		{
-		freecmd(comm);
+		freecopy(comm);
 		lastval = 1;
 		return;
 		}
@@ -616,34 +664,59 @@ list l;
 
 	gstat = (chn) ? chn->globstat : GLOB;
 
+	/* the path of an external command is looked up here, once.  A
+		plain one is started with vfork by spawn(), after doing its
+		redirections and substitutions here; if it isn't found, and
+		nothing waits on it, we needn't fork at all. */
+
+	if (type == SIMPLE && !iscursh && !comm->vars)
+		{
+		spath = execpath(comm->cmd);
+		vspawn = !(comm->flags & CFLAG_EXEC) && !(last1 && execok()) &&
+			canspawn(comm,input,output) && (spath || !(bkg || input || output));
+		}
+
+	/* get what we can of the trace record now.  It is written when
+		the command finishes: below, or when its process is reaped. */
+
+	if (tracefd != -1 && (type == SIMPLE || type == SHFUNC))
+		{
+		trace = tracebeg((comm->cmd) ? comm->cmd : (char *) args->first->dat,
+			traceid);
+		tstart = tracenow();
+		}
+
 	/* if this command is backgrounded or (this is an external
 		command and we are not exec'ing it) or this is a builtin
 		with output piped somewhere, then fork.  If this is the
 		last stage in a subshell pipeline, don't fork, but make
 		the rest of the function think we forked. */
 
-	if (bkg || !(iscursh || (comm->flags & CFLAG_EXEC)) ||
-			(chn && chn->type == BUILTIN && output))
+	if (!vspawn && (bkg || !(iscursh || (comm->flags & CFLAG_EXEC)) ||
+			(chn && chn->type == BUILTIN && output)))
 		{
 		pid = (last1 && execok()) ? 0 : phork();
 		if (pid == -1)
+			{
+			if (trace)
+				free(trace);
+			freecopy(comm);
 			return;
+			}
 		if (pid)
 			{
-			if (pid == -1)
-				zerr("%e",errno);
-			else
-				(void) addproc(pid,text);
+			pn = addproc(pid,text);
+			pn->trace = trace;
+			pn->tstart = tstart;
+			freecopy(comm);
 			return;
 			}
-		entersubsh(bkg);
+		entersubsh(bkg,1);
 		forked = 1;
 		}
-	if (bkg && isset(BGNICE))	/* stupid */
-		nice(5);
-	if (input)		/* add pipeline input/output to mnodes */
+	if (input && !vspawn)		/* add pipeline input/output to mnodes */
 		addfd(forked,save,mfds,0,input,0);
-	if (output)
+	if (output && !vspawn)
 		addfd(forked,save,mfds,1,output,1);
 	spawnpipes(comm->redir);		/* do process substitutions */
 	while (full(comm->redir))
@@ -669,11 +742,18 @@ list l;
 					continue;
 			if (fn->type == READ || fn->type == HEREDOC)
 				{
-				fil = (fn->type == READ) ? open(fn->u.name,O_RDONLY) : fn->u.fd2;
+				if (fn->type == READ)
+					fil = open(fn->u.name,O_RDONLY);
+				else		/* the parse tree's arena keeps the original */
+					{
+					lseek(fn->u.fd2,0L,0);
+					fil = dup(fn->u.fd2);
+					}
 				if (fil == -1)
 					{
 					if (errno != EINTR)
-						zerr("%e: %s",errno,fn->u.name);
+						zerr("%e: %s",errno,(fn->type == READ) ? fn->u.name :
+							"here document");
 					execerr();
 					}
 				addfd(forked,save,mfds,fn->fd1,fil,0);
@@ -721,6 +801,8 @@ list l;
 	if (errflag)
 		{
 		lastval = 1;
+		if (vspawn)		/* as if it had happened in the child */
+			errflag = 0;
 		goto err;
 		}
 	
@@ -736,7 +818,11 @@ list l;
 				execfor,execwhile,execrepeat,execif,execcase,execselect};
 	
 			fixcline(comm->args);
+			if (trace && type == SHFUNC)
+				tracecall(traceid,tracesave);
 			(func[type-CURSH])(comm);
+			if (trace && type == SHFUNC)
+				tracereturn(tracesave);
 			fflush(stdout);
 			if (ferror(stdout))
 				{
@@ -764,10 +850,28 @@ list l;
 			{
 			if (comm->vars)
 				addenv(comm->vars);
-			if (type == SIMPLE)
+			if (vspawn && !spath)
+				{
+				zerr("command not found: %s",comm->cmd);
+				lastval = 1;
+				}
+			else if (vspawn)
+				{
+				char **argv = makecline(comm->cmd,args);
+
+				if ((pid = spawn(spath,argv,input,output,bkg)) != -1)
+					{
+					pn = addproc(pid,text);
+					pn->trace = trace;
+					pn->tstart = tstart;
+					trace = NULL;
+					}
+				free(argv);
+				}
+			else if (type == SIMPLE)
 				{
 				closem();
-				execute(comm->cmd,args);
+				execute(comm->cmd,spath,args);
 				}
 			else	/* ( ... ) */
 				execlist(comm->left);
@@ -775,51 +879,119 @@ list l;
 err:
 	if (forked)
 		_exit(lastval);
+	if (trace)
+		traceend(trace,tstart,getpid(),lastval);
 	fixfds(save);
-	freecmd(comm);
+	if (spath)
+		free(spath);
+	freecopy(comm);
 }
 
-/* restore fds after redirecting a builtin */
+/* != 0 if a command can be run by spawn().  It mustn't have
+	assignments, which would go in the child's environment, and its
+	redirections must not get mixed up with its pipes, since those
+	are set up in the child.  Process substitutions and closing
+	fds need a child of their own. */
 
-void fixfds(int save[10])
+int canspawn(comm comm,int input,int output)
 {
-int t0;
+Node n;
+struct fnode *f;
 
-	for (t0 = 0; t0 != 10; t0++)
-		if (save[t0])
-			redup(save[t0],t0);
+	if (comm->vars || isset(NOEXEC) || getenv("STTY") || getenv("ARGV0"))
+		return 0;
+	for (n = comm->redir->first; n; n = n->next)
+		{
+		f = n->dat;
+		if (f->type == CLOSE || f->type == INPIPE || f->type == OUTPIPE ||
+				((f->type == MERGE || f->type == MERGEOUT) && (input || output)) ||
+				(input && f->fd1 == 0) || (output && f->fd1 == 1))
+			return 0;
+		}
+	return 1;
+}
+
+/* errno from a failed execve in spawn()'s child */
+
+static int spawnerr;
+
+/* start an external command with vfork.  The child shares our
+	memory until it execs, so it only makes system calls: it does
+	what entersubsh() and execute() would do, and leaves us its errno
+	if the execve fails.  All signals are blocked across the vfork,
+	so that none of our handlers runs in the child before it has put
+	them back to the defaults. */
+
+long spawn(char *path,char **argv,int input,int output,int bkg)
+{
+long pid,pg = (jobbing) ? jobtab[curjob].gleader : 0;
+struct sigaction sa;
+int t0,mask;
+
+	spawnerr = 0;
+	pathcheck = 0;
+	mask = sigblock(~0);
+	if ((pid = vfork()) == -1)
+		{
+		sigsetmask(mask);
+		zerr("fork failed: %e",errno);
+		return -1;
+		}
+	if (!pid)
+		{
+		for (t0 = 1; t0 != NSIG; t0++)	/* our handlers mustn't run here */
+			if (!sigaction(t0,NULL,&sa) && sa.sa_handler != SIG_DFL &&
+					sa.sa_handler != SIG_IGN)
+				signal(t0,SIG_DFL);
+		if (spawnerr = childsetup(bkg,bkg,pg))
+			_exit(1);
+		if (input)
+			dup2(input,0);
+		if (output)
+			dup2(output,1);
+		closem();
+		sigsetmask(0);
+		execve(path,argv,environ);
+		spawnerr = errno;
+		_exit(1);
+		}
+	sigsetmask(mask);
+	if (spawnerr)
+		zerr("%e: %s",spawnerr,path);
+	return pid;
 }
 
-void entersubsh(int bkg)
+/* set up a new child to run a command or a subshell: its limits,
+	process group and tty, stdin for a background job without job
+	control, the signals that go back to their defaults and the
+	niceness of a background job when nicebkg is set.  This only
+	makes system calls, so spawn()'s vfork child can use it too.
+	Returns 0, or errno if the child can't go on. */
+
+int childsetup(int bkg,int nicebkg,long pg)
 {
+pid_t me;
+int t0;
+
+	for (t0 = 0; t0 != RLIM_NLIMITS; t0++)
+		setrlimit(t0,limits+t0);
 	if (!jobbing)
 		{
 		if (bkg && isatty(0))
 			{
 			close(0);
 			if (open("/dev/null",O_RDWR))
-				{
-				zerr("can't open /dev/null: %e",errno);
-				_exit(1);
-				}
+				return errno;
 			}
 		}
-	else if (!jobtab[curjob].gleader)
-		{
-		setpgrp(0L,jobtab[curjob].gleader = getpid());
-		if (!bkg)
-			attachtty(jobtab[curjob].gleader);
-		}
 	else
-		setpgrp(0L,jobtab[curjob].gleader);
-	subsh = 1;
-	if (SHTTY != -1)
-		{
-		close(SHTTY);
-		SHTTY = -1;
-		}
-	if (jobbing)
 		{
+		setpgid(0,pg);
+		if (!pg && !bkg && SHTTY != -1)
+			{
+			me = getpid();
+			ioctl(SHTTY,TIOCSPGRP,&me);
+			}
 		signal(SIGTTOU,SIG_DFL);
 		signal(SIGTTIN,SIG_DFL);
 		signal(SIGTSTP,SIG_DFL);
@@ -833,6 +1005,42 @@ void entersubsh(int bkg)
 		}
 	if (!sigtrapped[SIGQUIT])
 		signal(SIGQUIT,SIG_DFL);
+	if (nicebkg && bkg && isset(BGNICE))	/* stupid */
+		nice(5);
+	return 0;
+}
+
+/* restore fds after redirecting a builtin */
+
+void fixfds(int save[10])
+{
+int t0;
+
+	for (t0 = 0; t0 != 10; t0++)
+		if (save[t0])
+			redup(save[t0],t0);
+}
+
+/* set up a forked subshell; nicebkg is passed to childsetup() */
+
+void entersubsh(int bkg,int nicebkg)
+{
+int err;
+
+	if (err = childsetup(bkg,nicebkg,(jobbing) ? jobtab[curjob].gleader : 0))
+		{
+		zerr("can't open /dev/null: %e",err);
+		_exit(1);
+		}
+	if (jobbing && !jobtab[curjob].gleader)
+		jobtab[curjob].gleader = getpid();
+	subsh = 1;
+	mksigfds();
+	if (SHTTY != -1)
+		{
+		close(SHTTY);
+		SHTTY = -1;
+		}
 	opts[MONITOR] = OPT_UNSET;
 	clearjobtab();
 }
@@ -946,6 +1154,7 @@ int ret = 0;
 table getoutput(char *cmd,int qt)
 {
 list list;
+struct arena *ar;
 int pipes[2];
 
 	if (*cmd == '<')
@@ -970,9 +1179,9 @@ int pipes[2];
 			}
 		return readoutput(stream,qt);
 		}
-	hungets(strdup(cmd));
+	hungets(cmd);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -980,6 +1189,7 @@ int pipes[2];
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -988,13 +1198,14 @@ int pipes[2];
 	mpipe(pipes);
 	if (phork())
 		{
+		freearena(ar);
 		close(pipes[1]);
 		return readoutput(pipes[0],qt);
 		}
 	subsh = 1;
 	close(pipes[0]);
 	redup(pipes[1],1);
-	entersubsh(0);
+	entersubsh(0,0);
 	signal(SIGTSTP,SIG_IGN);
 	exiting = 1;
 	execlist(list);
@@ -1038,7 +1249,8 @@ FILE *fin;
 				}
 			}
 	if (qt && ptr != buf && ptr[-1] == '\n')
-		ptr[-1] = '\0';
+		ptr--;
+	*ptr = '\0';
 	if (cnt)
 		addnode(ret,strdup(buf));
 	free(buf);
@@ -1056,14 +1268,15 @@ int pid;
 char *nam = gettemp(),*str;
 int tfil;
 list list;
+struct arena *ar;
 
 	for (str = cmd; *str && *str != Outpar; str++);
 	if (!*str)
 		zerr("oops.");
 	*str = '\0';
-	hungets(strdup(cmd));
+	hungets(cmd);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		hflush();
 		strinend();
@@ -1071,6 +1284,7 @@ list list;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -1083,15 +1297,19 @@ list list;
 	if (pid = phork())
 		{
 		waitpid(pid,NULL,WUNTRACED);
+		freearena(ar);
 		return nam;
 		}
 #else
 	if (waitfork())
+		{
+		freearena(ar);
 		return nam;
+		}
 #endif
 	subsh = 1;
 	close(1);
-	entersubsh(0);
+	entersubsh(0,0);
 	tfil = creat(nam,0666);
 	exiting = 1;
 	execlist(list);
@@ -1114,6 +1332,7 @@ char *tnam = gettemp();
 char *getoutproc(char *cmd)
 {
 list list;
+struct arena *ar;
 int fd;
 char *pnam,*str;
 
@@ -1121,9 +1340,9 @@ char *pnam,*str;
 	if (!*str)
 		zerr("oops.");
 	*str = '\0';
-	hungets(strdup(cmd));
+	hungets(cmd);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -1131,6 +1350,7 @@ char *pnam,*str;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -1141,8 +1361,11 @@ char *pnam,*str;
 		jobtab[curjob].filelist = newtable();
 	addnode(jobtab[curjob].filelist,strdup(pnam));
 	if (phork())
+		{
+		freearena(ar);
 		return pnam;
-	entersubsh(1);
+		}
+	entersubsh(1,0);
 	fd = open(pnam,O_WRONLY);
 	if (fd == -1)
 		{
@@ -1163,6 +1386,7 @@ char *pnam,*str;
 char *getinproc(char *cmd)
 {
 list list;
+struct arena *ar;
 int pid,fd;
 char *pnam,*str;
 
@@ -1170,9 +1394,9 @@ char *pnam,*str;
 	if (!*str)
 		zerr("oops.");
 	*str = '\0';
-	hungets(strdup(cmd));
+	hungets(cmd);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -1180,6 +1404,7 @@ char *pnam,*str;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -1190,8 +1415,11 @@ char *pnam,*str;
 		jobtab[curjob].filelist = newtable();
 	addnode(jobtab[curjob].filelist,strdup(pnam));
 	if (pid = phork())
+		{
+		freearena(ar);
 		return pnam;
-	entersubsh(1);
+		}
+	entersubsh(1,0);
 	fd = open(pnam,O_RDONLY);
 	redup(fd,0);
 	exiting = 1;
@@ -1204,6 +1432,7 @@ char *pnam,*str;
 int getinpipe(char *cmd)
 {
 list list;
+struct arena *ar;
 int pipes[2];
 char *str = cmd;
 
@@ -1211,9 +1440,9 @@ char *str = cmd;
 	if (!*str)
 		zerr("oops.");
 	*str = '\0';
-	hungets(strdup(cmd+2));
+	hungets(cmd+2);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -1221,6 +1450,7 @@ char *str = cmd;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -1229,11 +1459,12 @@ char *str = cmd;
 	mpipe(pipes);
 	if (phork())
 		{
+		freearena(ar);
 		close(pipes[1]);
 		return pipes[0];
 		}
 	close(pipes[0]);
-	entersubsh(1);
+	entersubsh(1,0);
 	redup(pipes[1],1);
 	exiting = 1;
 	execlist(list);
@@ -1245,6 +1476,7 @@ char *str = cmd;
 int getoutpipe(char *cmd)
 {
 list list;
+struct arena *ar;
 int pipes[2];
 char *str;
 
@@ -1252,9 +1484,9 @@ char *str;
 	if (!*str)
 		zerr("oops.");
 	*str = '\0';
-	hungets(strdup(cmd+2));
+	hungets(cmd+2);
 	strinbeg();
-	if (!(list = parlist(1)))
+	if (!(list = parlista(1,&ar)))
 		{
 		strinend();
 		hflush();
@@ -1262,6 +1494,7 @@ char *str;
 		}
 	if (peek != EOF && peek != EMPTY)
 		{
+		freearena(ar);
 		strinend();
 		hflush();
 		return NULL;
@@ -1270,11 +1503,12 @@ char *str;
 	mpipe(pipes);
 	if (phork())
 		{
+		freearena(ar);
 		close(pipes[0]);
 		return pipes[1];
 		}
 	close(pipes[1]);
-	entersubsh(1);
+	entersubsh(1,0);
 	redup(pipes[0],0);
 	exiting = 1;
 	execlist(list);
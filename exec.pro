@@ -2,13 +2,15 @@ void execstring(char *s);
 void newrunlist(list l);
 int phork(void);
 void execcursh(comm comm);
-void execute(char *arg0,table args);
+void execute(char *arg0,char *pnam,table args);
+char *execpath(char *arg0);
 char *findcmd(char *arg0);
 void execlist(list list);
 void execlist1(list list);
 void execlist2(list2 list,int type,int last1);
 int execpline(list2 l,int how,int last1);
-void execpline2(pline pline,int how,int input,int output,int last1);
+int runpline(struct pstage *ps,int flags,int how,int last1);
+void execpline2(struct pstage *ps,int how,int input,int output,int last1);
 char **makecline(char *nam,struct xlist *list);
 void fixcline(table l);
 void untokenize(char *s);
@@ -17,9 +19,13 @@ int dontclob(struct fnode *f);
 void closemn(struct mnode *mfds[10],int fd);
 void closemnodes(struct mnode *mfds[10]);
 void addfd(int forked,int save[10],struct mnode *mfds[10],int fd1,int fd2,int rflag);
-void execcomm(comm comm,int input,int output,int bkg,int last1);
+void execcomm(comm xcomm,int input,int output,int bkg,int last1);
+void runcomm(comm comm,int input,int output,int bkg,int last1);
 void fixfds(int save[10]);
-void entersubsh(int bkg);
+int canspawn(comm comm,int input,int output);
+long spawn(char *path,char **argv,int input,int output,int bkg);
+int childsetup(int bkg,int nicebkg,long pg);
+void entersubsh(int bkg,int nicebkg);
 void closem(void);
 int gethere(char *str);
 void catproc(struct mnode *mn);
@@ -35,6 +35,8 @@
 #include "subst.pro"
 #include "builtin.pro"
 #include "loop.pro"
+#include "code.pro"
+#include "prof.pro"
 #include "jobs.pro"
 #include "exec.pro"
 #include "init.pro"
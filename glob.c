@@ -36,19 +36,64 @@
 #endif
 #include <sys/dir.h>
 #include <sys/errno.h>
-
-#define exists(X) (access(X,0) == 0)
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #define magicerr() { if (magic) putc('\n',stderr); errflag = 1; }
 
 static int gtype;	/* file type for (X) */
 static int mode;	/* != 0 if we are parsing glob patterns */
 static int sense; /* (X) or (^X) */
-static int pathpos;	/* position in pathbuf */
-static int matchsz;	/* size of matchbuf */
-static int matchct;	/* number of matches found */
-static char pathbuf[MAXPATHLEN];	/* pathname buffer */
-static char **matchbuf;		/* array of matches */
-static char **matchptr;		/* &matchbuf[matchct] */
+
+/* the file type of a directory entry, or 0 if the system doesn't say */
+
+#ifdef DT_UNKNOWN
+#define DETYPE(de) (((de)->d_type == DT_UNKNOWN) ? 0 : DTTOIF((de)->d_type))
+#else
+#define DETYPE(de) 0
+#endif
+
+/* the most threads used to scan for (foo/)# */
+
+#define MAXGLOBTHREADS 16
+
+/* the state of a scan.  Each thread of a parallel scan has its own. */
+
+struct xscan {
+	int pathpos;	/* position in pathbuf */
+	int matchsz;	/* size of matchbuf */
+	int matchct;	/* number of matches found */
+	char pathbuf[MAXPATHLEN];	/* pathname buffer */
+	char **matchbuf;		/* array of matches */
+	struct gwork *work;	/* directories this thread has yet to scan, */
+	int worklo,workhi;	/* work[worklo] to work[workhi-1] */
+	int worksz;			/* size of work */
+	};
+
+/* a directory left to scan in a parallel scan */
+
+struct gwork {
+	qath q;		/* pattern for the rest of the path */
+	char *path;	/* the directory, as in pathbuf */
+	};
+
+/* a parallel scan.  Each thread takes the directories it finds
+	itself last first, so as to go depth first like scanner() does,
+	and when it has none left takes the oldest one another thread
+	has found.  The lists are small, so one mutex does for them all.
+	Only the first thread, which the signals go to, touches errflag;
+	the others stop on scanstop, and leave their error for it. */
+
+static scan scans;	/* one for each thread, or NULL if not parallel */
+static int nscans;	/* number of them */
+static int busy;		/* number of threads scanning a directory */
+static int rootfd;	/* the directory the pattern starts in */
+static int scanstop;	/* set to stop the threads, atomically */
+static int scanerrno;	/* the first error in the scan, */
+static char *scanerrstr;	/* and what it was about */
+static pthread_mutex_t gmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gcond = PTHREAD_COND_INITIALIZER;
 
 /* pathname component in filename patterns */
 
@@ -59,9 +104,42 @@ struct xpath {
 	comp comp;
 	int closure;	/* 1 if this is a (foo/)# */
 	};
+
+/* a compiled pattern.  This is a program for a little machine that
+	matches strings; see doesmatch(). */
+
 struct xcomp {
-	comp nx1,nx2;
-	char *str;
+	struct pinst *prog;	/* the instructions */
+	int ninst;			/* number of them */
+	struct pset *sets;	/* the [...]s in it */
+	int nsets;			/* number of them */
+	int start;			/* the instruction to start with */
+	char *str;			/* the pattern, if it has no wildcards, else NULL */
+	};
+
+/* an instruction of a compiled pattern.  x is where to go next;
+	y and z depend on op. */
+
+struct pinst {
+	int op,x,y,z;
+	};
+
+#define P_CHAR		0	/* the character y */
+#define P_ANY		1	/* any character (?) */
+#define P_SET		2	/* a character in sets[y] ([...]) */
+#define P_NUM		3	/* a number from y to z (<y-z>) */
+#define P_SPLIT	4	/* both x and y */
+#define P_JMP		5	/* nothing */
+#define P_NOT		6	/* match if the rest does not match from x (^) */
+#define P_ANYREST	7	/* match whatever is left (a final *) */
+#define P_MATCH	8	/* match if at the end of the string */
+
+/* a [...].  alts are the (...)s in it, each followed by a null. */
+
+struct pset {
+	unsigned char map[32];	/* bit c set if c is in the set */
+	char *alts;
+	int nalts;
 	};
 
 void glob(table list,Node *np)
@@ -70,8 +148,11 @@ Node node = (*np)->last;	/* the node before this one */
 Node next = (*np)->next;	/* the node after this one */
 int sl;		/* length of the pattern */
 char *ostr;	/* the pattern before the parser chops it up */
-char *wd;	/* the cwd */
+int dfd;		/* the directory the pattern starts in */
 qath q;		/* pattern after parsing */
+scan s;		/* where the matches are put */
+char **matchptr;	/* the next match */
+int matchct;
 char *str = (*np)->dat;	/* the pattern */
 
 	sl = strlen(str);
@@ -116,22 +197,17 @@ char *str = (*np)->dat;	/* the pattern */
 		gtype = S_IFDIR;
 		sense = 0;
 		}
+	s = alloc(sizeof(struct xscan));
 	if (*str == '/')	/* pattern has absolute path */
 		{
-		wd = zgetwd();
 		str++;
-		chdir("/");
-		pathbuf[0] = '/';
-		pathbuf[pathpos = 1] = '\0';
-		}
-	else		/* pattern is relative to cwd */
-		{
-		wd = NULL;
-		pathbuf[pathpos = 0] = '\0';
+		s->pathbuf[0] = '/';
+		s->pathbuf[s->pathpos = 1] = '\0';
 		}
 	q = parsepat(str);
 	if (!q || errflag)	/* if parsing failed */
 		{
+		free(s);
 		if (isset(NOBADPATTERN))
 			{
 			insnode(list,node,ostr);
@@ -142,16 +218,19 @@ char *str = (*np)->dat;	/* the pattern */
 		free(ostr);
 		return;
 		}
-	matchptr = matchbuf = (char **) zalloc((matchsz = 16)*sizeof(char *));
-	matchct = 0;
-	scanner(q);		/* do the globbing */
-	freepath(q);
-	if (wd)		/* reset cwd */
+	s->matchbuf = (char **) zalloc((s->matchsz = 16)*sizeof(char *));
+	if (*s->pathbuf)
 		{
-		chdir(wd);
-		free(wd);
+		if ((dfd = open("/",O_RDONLY|O_DIRECTORY)) != -1)
+			{
+			parscan(s,q,dfd);		/* do the globbing */
+			close(dfd);
+			}
 		}
-	if (!matchct && unset(NULLGLOB))
+	else
+		parscan(s,q,AT_FDCWD);
+	freepath(q);
+	if (!s->matchct && unset(NULLGLOB))
 		if (unset(NONOMATCH))
 			{
 			if (!errflag)
@@ -159,21 +238,23 @@ char *str = (*np)->dat;	/* the pattern */
 				magicerr();
 				zerr("no matches found: %s",ostr);
 				}
-			free(matchbuf);
+			free(s->matchbuf);
+			free(s);
 			free(ostr);
 			errflag = 1;
 			return;
 			}
 		else
 			{
-			*matchptr++ = strdup(ostr);
-			matchct = 1;
+			s->matchbuf[0] = strdup(ostr);
+			s->matchct = 1;
 			}
-	qsort(&matchbuf[0],matchct,sizeof(char *),notstrcmp);
-	matchptr = matchbuf;
-	while (matchct--)			/* insert matches in the arg list */
+	qsort(&s->matchbuf[0],s->matchct,sizeof(char *),notstrcmp);
+	matchptr = s->matchbuf;
+	for (matchct = s->matchct; matchct--; )	/* insert matches in the arg list */
 		insnode(list,node,*matchptr++);
-	free(matchbuf);
+	free(s->matchbuf);
+	free(s);
 	free(ostr);
 	if (magic)
 		magic = 2;	/* tell readline we did something */
@@ -188,13 +269,17 @@ char *c = *b,*d = *a;
 	return ((int) (unsigned char) *c-(int) (unsigned char) *d);
 }
 
-/* add a match to the list */
+/* add a match, fn in the directory dfd, to the list.  type is its
+	file type, or 0 if that isn't known yet. */
 
-void insert(char *s)
+void insert(scan sc,int dfd,char *fn,int type)
 {
 struct stat buf;
+char *s = dyncat(sc->pathbuf,fn);
 
-	if (isset(MARKDIRS) && !lstat(s,&buf) && S_ISDIR(buf.st_mode)) /* grrr */
+	if (isset(MARKDIRS) && !type && !fstatat(dfd,fn,&buf,AT_SYMLINK_NOFOLLOW))
+		type = buf.st_mode & S_IFMT;
+	if (isset(MARKDIRS) && type == S_IFDIR)
 		{
 		char *t;
 		int ll = strlen(s);
@@ -206,12 +291,15 @@ struct stat buf;
 		free(s);
 		s = t;
 		}
-	*matchptr++ = s;
-	if (++matchct == matchsz)
-		{
-		matchbuf = (char **) realloc(matchbuf,sizeof(char **)*(matchsz *= 2));
-		matchptr = matchbuf+matchct;
-		}
+	addmatch(sc,s);
+}
+
+void addmatch(scan sc,char *s)
+{
+	sc->matchbuf[sc->matchct] = s;
+	if (++sc->matchct == sc->matchsz)
+		sc->matchbuf = (char **) realloc(sc->matchbuf,
+			sizeof(char **)*(sc->matchsz *= 2));
 }
 
 /* check to see if str is eligible for filename generation */
@@ -530,16 +618,56 @@ char *t,*lng = NULL,cc,*s = *sp;
 
 /* add a component to pathbuf */
 
-void addpath(char *s)
+void addpath(scan s,char *str)
+{
+	while (s->pathbuf[s->pathpos++] = *str++);
+	s->pathbuf[s->pathpos-1] = '/';
+	s->pathbuf[s->pathpos] = '\0';
+}
+
+/* report an error in scanning.  The scan stops at the first error,
+	so in a parallel scan only the first is reported. */
+
+void scanerr(int err,char *str)
+{
+	if (scans)
+		{
+		pthread_mutex_lock(&gmutex);
+		if (!__atomic_load_n(&scanstop,__ATOMIC_RELAXED))
+			{
+			__atomic_store_n(&scanstop,1,__ATOMIC_RELAXED);
+			scanerrno = err;
+			scanerrstr = strdup(str);
+			}
+		pthread_mutex_unlock(&gmutex);
+		return;
+		}
+	if (!errflag)
+		{
+		magicerr();
+		if (err != EINTR)
+			zerr("%e: %s",err,str);
+		}
+}
+
+/* != 0 if the scan is to stop.  The first thread of a parallel
+	scan passes an interrupt on to the others. */
+
+static int scanstopped(scan s)
 {
-	while (pathbuf[pathpos++] = *s++);
-	pathbuf[pathpos-1] = '/';
-	pathbuf[pathpos] = '\0';
+	if (!scans)
+		return errflag;
+	if (s == scans && errflag)
+		__atomic_store_n(&scanstop,1,__ATOMIC_RELAXED);
+	return __atomic_load_n(&scanstop,__ATOMIC_RELAXED);
 }
 
-/* do the globbing */
+/* do the globbing.  dfd is the directory in pathbuf, or AT_FDCWD;
+	the directories are opened relative to it, so we never chdir.
+	In a parallel scan, the directories to go down into are left for
+	the threads instead. */
 
-void scanner(qath q)
+void scanner(scan s,qath q,int dfd)
 {
 comp c;
 
@@ -547,91 +675,85 @@ comp c;
 		if (q->closure == 2)		/* (foo/)## */
 			q->closure = 1;
 		else
-			scanner(q->next);
+			scanner(s,q->next,dfd);
 	if (c = q->comp)
 		{
-		if (!(c->nx1 || c->nx2) && !haswilds(c->str))
+		if (c->str)
 			if (q->next)
 				{
-				char *wd = NULL;
-				
-				if (errflag)
+				int fd;
+
+				if (scanstopped(s))
 					return;
-				if (islink(c->str) || !strcmp(c->str,".."))
-					wd = zgetwd();
-				if (!chdir(c->str))
+				if ((fd = openat(dfd,c->str,O_RDONLY|O_DIRECTORY)) != -1)
 					{
-					int oppos = pathpos;
+					int oppos = s->pathpos;
 					
-					addpath(c->str);
-					scanner((q->closure) ? q : q->next);
-					if (wd)
-						chdir(wd);
-					else if (strcmp(c->str,"."))
-						chdir("..");
-					pathbuf[pathpos = oppos] = '\0';
+					addpath(s,c->str);
+					scanner(s,(q->closure) ? q : q->next,fd);
+					close(fd);
+					s->pathbuf[s->pathpos = oppos] = '\0';
 					}
 				else
 					{
-					magicerr();
-					zerr("%e: %s",errno,c->str);
-					if (wd)
-						chdir(wd);
-					else if (strcmp(c->str,"."))
-						chdir("..");
+					scanerr(errno,c->str);
 					return;
 					}
 				}
 			else
 				{
-				if (exists(c->str))
-					insert(dyncat(pathbuf,c->str));
+				if (!faccessat(dfd,c->str,F_OK,0))
+					insert(s,dfd,c->str,0);
 				}
 		else
 			{
 			char *fn;
-			int type,type3,dirs = !!q->next;
+			int fd,type,type3,dirs = !!q->next;
 			struct direct *de;
-			DIR *lock = opendir(".");
-			static struct stat buf;
+			DIR *lock;
+			struct stat buf;
 			 
-			if (lock == NULL)
+			if ((fd = openat(dfd,".",O_RDONLY|O_DIRECTORY)) == -1 ||
+					!(lock = fdopendir(fd)))
 				{
-				magicerr();
-				if (errno != EINTR)
-					zerr("%e: %s",errno,pathbuf);
+				scanerr(errno,s->pathbuf);
+				if (fd != -1)
+					close(fd);
 				return;
 				}
-			readdir(lock); readdir(lock); 	/* skip . and .. */
+			dfd = dirfd(lock);
 			while (de = readdir(lock))
 				{
-				if (errflag)
+				if (scanstopped(s))
 					break;
 				fn = &de->d_name[0];
-				if (dirs)
+				if (fn[0] == '.' && (!fn[1] || (fn[1] == '.' && !fn[2])))
+					continue;	/* skip . and .. */
+				if (!doesmatch(fn,c,unset(GLOBDOTS)))
+					continue;
+
+				/* the type from readdir will do, unless we need the
+					permissions, or the system doesn't say */
+
+				type3 = DETYPE(de);
+				if ((dirs || gtype) && (!type3 || (!dirs && (gtype & 0777))))
 					{
-					if (lstat(fn,&buf) == -1)
+					if (fstatat(dfd,fn,&buf,AT_SYMLINK_NOFOLLOW) == -1)
 						{
-						magicerr();
-						zerr("%e: %s",errno,fn);
+						if (dirs || errno != ENOENT)
+							scanerr(errno,fn);
+						continue;
 						}
-					type3 = buf.st_mode & S_IFMT;
+					type3 = (type = buf.st_mode) & S_IFMT;
+					}
+				if (dirs)
+					{
 					if (type3 != S_IFDIR)
 						continue;
 					}
 				else
 					if (gtype)	/* do the (X) (^X) stuff */
 						{
-						if (lstat(fn,&buf) == -1)
-							{
-							if (errno != ENOENT)
-								{
-								magicerr();
-								zerr("%e: %s",errno,fn);
-								}
-							continue;
-							}
-						type3 = (type = buf.st_mode) & S_IFMT;
 						if (gtype & 0777)
 							{
 							if ((!(type & gtype) ^ sense) || type3 == S_IFLNK)
@@ -645,21 +767,22 @@ comp c;
 						else if ((gtype != type3) ^ sense)
 							continue;
 						}
-				if (doesmatch(fn,c,unset(GLOBDOTS)))
-					if (dirs)
+				if (dirs)
+					{
+					int oppos = s->pathpos;
+
+					addpath(s,fn);
+					if (scans)
+						pushwork(s,(q->closure) ? q : q->next);
+					else if ((fd = openat(dfd,fn,O_RDONLY|O_DIRECTORY)) != -1)
 						{
-						if (!chdir(fn))
-							{
-							int oppos = pathpos;
-					
-							addpath(fn);
-							scanner((q->closure) ? q : q->next); /* scan next level */
-							chdir("..");
-							pathbuf[pathpos = oppos] = '\0';
-							}
+						scanner(s,(q->closure) ? q : q->next,fd); /* scan next level */
+						close(fd);
 						}
-					else
-						insert(dyncat(pathbuf,fn));
+					s->pathbuf[s->pathpos = oppos] = '\0';
+					}
+				else
+					insert(s,dfd,fn,type3);
 				}
 			closedir(lock);
 			}
@@ -671,141 +794,333 @@ comp c;
 		}
 }
 
-/* do the [..(foo)..] business */
+/* leave the directory in pathbuf for a thread to scan */
 
-int minimatch(char **pat,char **str)
+void pushwork(scan s,qath q)
 {
-char *pt = *pat+1,*s = *str;
-	
-	for (; *pt != Outpar; s++,pt++)
-		if ((*pt != Quest || !*s) && *pt != *s)
-			{
-			*pat = getparen(*pat)-1;
-			return 0;
-			}
-	*str = s-1;
-	return 1;
+	pthread_mutex_lock(&gmutex);
+	if (s->workhi == s->worksz)
+		s->work = realloc(s->work,(s->worksz = s->worksz*2+16)*
+			sizeof(struct gwork));
+	s->work[s->workhi].q = q;
+	s->work[s->workhi++].path = strdup(s->pathbuf);
+	pthread_cond_signal(&gcond);
+	pthread_mutex_unlock(&gmutex);
 }
 
-/* see if str matches c; first means worry about matching . explicitly */
+/* get a directory to scan, with gmutex held: the last one this
+	thread found, or else the first one another thread found */
 
-int doesmatch(char *str,comp c,int first)
+static int getwork(scan s,struct gwork *w)
 {
-char *pat = c->str;
+scan o;
+int t0;
 
-	FOREVER
+	if (s->workhi != s->worklo)
+		{
+		*w = s->work[--s->workhi];
+		return 1;
+		}
+	s->worklo = s->workhi = 0;
+	for (t0 = 1; t0 != nscans; t0++)
 		{
-		if (!*pat)
+		o = scans+(s-scans+t0)%nscans;
+		if (o->workhi != o->worklo)
 			{
-			if (errflag)
-				return 0;
-			if (!(*str || c->nx1 || c->nx2))
-				return 1;
-			return (c->nx1 && doesmatch(str,c->nx1,first)) ||
-				(c->nx2 && doesmatch(str,c->nx2,first));
-			}
-		if (first && *str == '.' && *pat != '.')
-			return 0;
-		if (*pat == Star)	/* final * is not expanded to ?#; returns success */
+			*w = o->work[o->worklo++];
 			return 1;
-		first = 0;
-		if (*pat == Quest && *str)
-			{
-			str++;
-			pat++;
-			continue;
 			}
-		if (*pat == Hat)
-			return 1-doesmatch(str,c->nx1,first);
-		if (*pat == Inbrack)
-			if (pat[1] == Hat)
+		}
+	return 0;
+}
+
+/* the loop run by each thread of a parallel scan, until there is
+	nothing left to scan, or an error or interrupt.  The first thread
+	doesn't wait long, so as to see an interrupt soon.  The directories
+	are opened by their whole path from rootfd, which costs a lookup of
+	each component again, and finds whatever is there by then if one
+	was renamed; keeping a descriptor for each one queued could run
+	out of them in a wide tree. */
+
+void *globthread(void *arg)
+{
+scan s = arg;
+struct gwork w;
+struct timespec ts;
+int fd;
+
+	pthread_mutex_lock(&gmutex);
+	for (;;)
+		{
+		if (scanstopped(s))
+			break;
+		if (!getwork(s,&w))
+			{
+			if (!busy)
+				break;
+			if (s == scans)
 				{
-				for (pat += 2; *pat != Outbrack && *pat; pat++)
-					if (*pat == '-' && pat[-1] != Hat && pat[1] != Outbrack)
-						{
-						if (pat[-1] <= *str && pat[1] >= *str)
-							break;
-						}
-					else if (*str == *pat)
-						break;
-				if (!*pat)
+				clock_gettime(CLOCK_REALTIME,&ts);
+				if ((ts.tv_nsec += 100000000) >= 1000000000)
 					{
-					zerr("something is very wrong.");
-					return 0;
+					ts.tv_sec++;
+					ts.tv_nsec -= 1000000000;
 					}
-				if (*pat != Outbrack)
-					break;
-				pat++;
-				str++;
-				continue;
+				pthread_cond_timedwait(&gcond,&gmutex,&ts);
 				}
 			else
-				{
-				for (pat++; *pat != Outbrack && *pat; pat++)
-					if (*pat == Inpar)
-						{
-						if (minimatch(&pat,&str))
-							break;
-						}
-					else if (*pat == '-' && pat[-1] != Inbrack && pat[1] != Outbrack)
-						{
-						if (pat[-1] <= *str && pat[1] >= *str)
-							break;
-						}
-					else if (*str == *pat)
-						break;
-				if (!pat || !*pat)
-					{
-					zerr("oh dear.  that CAN'T be right.");
-					return 0;
-					}
-				if (*pat == Outbrack)
-					break;
-				for (str++; *pat != Outbrack; pat++);
-				pat++;
-				continue;
-				}
-		if (*pat == Inang)
+				pthread_cond_wait(&gcond,&gmutex);
+			continue;
+			}
+		busy++;
+		pthread_mutex_unlock(&gmutex);
+		if ((fd = openat(rootfd,w.path,O_RDONLY|O_DIRECTORY)) != -1)
 			{
-			int t1,t2,t3;
-			char *ptr;
+			strcpy(s->pathbuf,w.path);
+			s->pathpos = strlen(w.path);
+			scanner(s,w.q,fd);
+			close(fd);
+			}
+		free(w.path);
+		pthread_mutex_lock(&gmutex);
+		busy--;
+		}
+	pthread_cond_broadcast(&gcond);
+	pthread_mutex_unlock(&gmutex);
+	return NULL;
+}
+
+/* != 0 if a pattern is worth scanning in parallel: it has a (foo/)#
+	in it.  A (foo/)## is changed to (foo/)# by the first directory
+	it is used in, so one after the start would make the matches
+	depend on the order the directories are scanned in. */
+
+int parpat(qath q)
+{
+int ret = 0;
+
+	for (; q; q = q->next)
+		if (q->closure == 2 && ret)
+			return 0;
+		else if (q->closure)
+			ret = 1;
+		else
+			ret |= 2;
+	return ret & 1;
+}
+
+/* do the globbing, in parallel if the pattern has a (foo/)# in it
+	and there is more than one processor.  The matches are all put
+	in s. */
+
+void parscan(scan s,qath q,int dfd)
+{
+pthread_t tids[MAXGLOBTHREADS];
+sigset_t set,oset;
+int t0,nthr;
+scan o;
+
+	nthr = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthr > MAXGLOBTHREADS)
+		nthr = MAXGLOBTHREADS;
+	if (nthr < 2 || !parpat(q))
+		{
+		scanner(s,q,dfd);
+		return;
+		}
+	scans = alloc(nthr*sizeof(struct xscan));
+	nscans = nthr;
+	rootfd = dfd;
+	busy = 1;
+	scanstop = 0;
+	*scans = *s;
+	for (t0 = 1; t0 != nthr; t0++)
+		scans[t0].matchbuf = (char **) zalloc((scans[t0].matchsz = 16)*
+			sizeof(char *));
+
+	/* the signals are all handled by this thread */
+
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK,&set,&oset);
+	for (t0 = 1; t0 != nthr; t0++)
+		if (pthread_create(tids+t0,NULL,globthread,scans+t0))
+			break;
+	pthread_sigmask(SIG_SETMASK,&oset,NULL);
+	nthr = t0;
+	scanner(scans,q,dfd);
+	pthread_mutex_lock(&gmutex);
+	busy--;
+	pthread_mutex_unlock(&gmutex);
+	globthread(scans);
+	for (t0 = 1; t0 != nthr; t0++)
+		pthread_join(tids[t0],NULL);
+	if (scanerrstr)
+		{
+		if (!errflag)
+			{
+			magicerr();
+			if (scanerrno != EINTR)
+				zerr("%e: %s",scanerrno,scanerrstr);
+			}
+		free(scanerrstr);
+		scanerrstr = NULL;
+		}
+	*s = *scans;
+	for (t0 = 0; t0 != nscans; t0++)
+		{
+		o = scans+t0;
+		while (o->workhi != o->worklo)		/* left by an interrupt */
+			free(o->work[--o->workhi].path);
+		if (o->work)
+			free(o->work);
+		if (t0)
+			{
+			while (o->matchct)
+				addmatch(s,o->matchbuf[--o->matchct]);
+			free(o->matchbuf);
+			}
+		}
+	s->work = NULL;
+	s->worklo = s->workhi = s->worksz = 0;
+	free(scans);
+	scans = NULL;
+	nscans = 0;
+}
+
+/* see if the string matches one of the (...)s in a [...]; ? matches
+	any character */
+
+static int altmatch(char *alt,char *str)
+{
+	for (; *alt; alt++,str++)
+		if (!*str || (*alt != Quest && *alt != *str))
+			return 0;
+	return 1;
+}
+
+/* a place a run of a compiled pattern has yet to try */
+
+struct pstate {
+	int pc,pos;
+	};
+
+#define PUSH(P,Q) { if (sp == ssiz) stk = growstack(stk,sbuf,&ssiz); \
+	stk[sp].pc = (P); stk[sp++].pos = (Q); }
+
+/* double the size of the stack of a run */
 
-			if (*++pat == Outang)	/* handle <> case */
+static struct pstate *growstack(struct pstate *stk,struct pstate *sbuf,int *ssiz)
+{
+struct pstate *nstk = zalloc(2*sizeof(struct pstate)**ssiz);
+
+	memcpy(nstk,stk,sizeof(struct pstate)**ssiz);
+	if (stk != sbuf)
+		free(stk);
+	*ssiz *= 2;
+	return nstk;
+}
+
+/* run c from instruction pc at str+pos.  The program is followed
+	depth first, but each instruction is tried at each place in str
+	at most once, so the time taken is at worst the size of c times
+	the length of str.  A ^ starts a new run with its own record of
+	where it has been.  Nothing here is static, since the threads of
+	a parallel scan match at the same time. */
+
+static int runcomp(comp c,int pc,char *str,int pos,int len,int first)
+{
+unsigned char mbuf[256],*map = mbuf;	/* bit pc*(len+1)+pos set if tried */
+struct pstate sbuf[64],*stk = sbuf;
+int ssiz = 64,sp = 0,ret = 0,t0;
+long msiz = ((long) c->ninst*(len+1)+7)/8,bit;
+struct pinst *pi;
+struct pset *ps;
+char *s;
+
+	if (msiz > sizeof mbuf)
+		map = zalloc(msiz);
+	memset(map,0,msiz);
+	PUSH(pc,pos);
+	while (sp && !ret)
+		{
+		pc = stk[--sp].pc;
+		pos = stk[sp].pos;
+		FOREVER
+			{
+			bit = (long) pc*(len+1)+pos;
+			if (map[bit >> 3] & 1 << (bit & 7))
+				break;
+			map[bit >> 3] |= 1 << (bit & 7);
+			pi = c->prog+pc;
+			if (first && !pos && *str == '.' && pi->op != P_SPLIT &&
+					pi->op != P_JMP && (pi->op != P_CHAR || pi->y != '.'))
+				break;
+			switch (pi->op)
 				{
-				(void) zstrtol(str,&ptr,10);
-				if (ptr == str)
+				case P_CHAR:
+					if (str[pos] != pi->y)
+						break;
+					pos++;
+					pc = pi->x;
+					continue;
+				case P_ANY:
+					if (!str[pos])
+						break;
+					pos++;
+					pc = pi->x;
+					continue;
+				case P_SET:
+					ps = c->sets+pi->y;
+					for (s = ps->alts, t0 = ps->nalts; t0--; s += strlen(s)+1)
+						if (altmatch(s,str+pos))
+							PUSH(pi->x,pos+strlen(s));
+					t0 = (unsigned char) str[pos];
+					if (!(ps->map[t0 >> 3] & 1 << (t0 & 7)))
+						break;
+					pos++;
+					pc = pi->x;
+					continue;
+				case P_NUM:
+					t0 = zstrtol(str+pos,&s,10);
+					if (s == str+pos || t0 < pi->y || t0 > pi->z)
+						break;
+					pos = s-str;
+					pc = pi->x;
+					continue;
+				case P_SPLIT:
+					PUSH(pi->y,pos);
+					pc = pi->x;
+					continue;
+				case P_JMP:
+					pc = pi->x;
+					continue;
+				case P_NOT:
+					ret = !runcomp(c,pi->x,str,pos,len,first);
 					break;
-				str = ptr;
-				pat++;
-				}
-			else
-				{
-				t1 = zstrtol(str,&ptr,10);
-				if (ptr == str)
+				case P_ANYREST:
+					ret = 1;
 					break;
-				str = ptr;
-				t2 = zstrtol(pat,&ptr,10);
-				if (*ptr != '-')
-					exit(31);
-				t3 = zstrtol(ptr+1,&pat,10);
-				if (!t3)
-					t3 = INT_MAX;
-				if (*pat++ != Outang)
-					exit(21);
-				if (t1 < t2 || t1 > t3)
+				case P_MATCH:
+					ret = pos == len;
 					break;
 				}
-			continue;
-			}
-		if (*str == *pat)
-			{
-			str++;
-			pat++;
-			continue;
+			break;
 			}
-		break;
 		}
-	return 0;
+	if (map != mbuf)
+		free(map);
+	if (stk != sbuf)
+		free(stk);
+	return ret;
+}
+
+/* see if str matches c; first means worry about matching . explicitly */
+
+int doesmatch(char *str,comp c,int first)
+{
+	if (c->str)
+		return !strcmp(str,c->str);
+	return runcomp(c,c->start,str,0,strlen(str),first);
 }
 
 static char *pptr;
@@ -891,195 +1206,335 @@ kludge:
 	return NULL;
 }
 
-comp parsecomp(void)
+/* the pattern being compiled */
+
+static struct pinst *prog;
+static int plen,psize;
+static struct pset *psets;
+static int nsets,ssize;
+
+/* part of a pattern being compiled.  The places in it that are to
+	go to whatever comes after it ("holes") are kept in a list linked
+	through the holes themselves; hole 2*n is prog[n].x, and 2*n+1
+	is prog[n].y. */
+
+struct pfrag {
+	int start;	/* its first instruction */
+	int out;		/* its holes, or -1 */
+	};
+
+#define untok(X) ((istok(X) && (X) >= Pound) ? tokens[(X)-Pound] : (X))
+
+static int parsealt(struct pfrag *f);
+
+/* add an instruction to the pattern being compiled */
+
+static int emit(int op,int x,int y,int z)
+{
+	if (plen == psize)
+		prog = (struct pinst *) realloc(prog,
+			sizeof(struct pinst)*(psize = (psize) ? psize*2 : 16));
+	prog[plen].op = op;
+	prog[plen].x = x;
+	prog[plen].y = y;
+	prog[plen].z = z;
+	return plen++;
+}
+
+static int *hole(int h)
+{
+	return (h & 1) ? &prog[h >> 1].y : &prog[h >> 1].x;
+}
+
+/* make a list of holes go to instruction i */
+
+static void patch(int l,int i)
+{
+int nx;
+
+	for (; l != -1; l = nx)
+		{
+		nx = *hole(l);
+		*hole(l) = i;
+		}
+}
+
+/* join two lists of holes */
+
+static int append(int l1,int l2)
+{
+int l = l1;
+
+	if (l == -1)
+		return l2;
+	while (*hole(l) != -1)
+		l = *hole(l);
+	*hole(l) = l2;
+	return l1;
+}
+
+/* make f go round again after it is done, for x# or x## */
+
+static void closure(struct pfrag *f)
 {
-comp c = (comp) alloc(sizeof(struct xcomp)),c1,c2;
-char *s = c->str = alloc(MAXPATHLEN*2),*ls = NULL;
+int i = emit(P_SPLIT,f->start,-1,0);
+
+	patch(f->out,i);
+	if (*++pptr == Pound)
+		pptr++;
+	else
+		f->start = i;
+	f->out = 2*i+1;
+}
 
-	c->nx2 = NULL;
+/* parse a [...] into a set */
+
+static int parseset(void)
+{
+struct pset *ps;
+char *s = pptr+1,*t,*u,*a;
+int neg = 0,last = -1,alen = 0,t0;
+
+	for (t = s; *t && *t != Outbrack; t++);
+	if (!*t)
+		return -1;
+	if (nsets == ssize)
+		psets = (struct pset *) realloc(psets,
+			sizeof(struct pset)*(ssize = (ssize) ? ssize*2 : 4));
+	ps = psets+nsets;
+	memset(ps,0,sizeof *ps);
+	if (*s == Hat)
+		{
+		neg = 1;
+		s++;
+		}
+	for (; s != t; s++)
+		{
+		if (*s == Inpar && !neg)
+			for (u = s+1; u != t && *u != Outpar; u++);
+		if (*s == Inpar && !neg && u != t)
+			{
+			ps->alts = (char *) realloc(ps->alts,alen+(u-s));
+			for (a = ps->alts+alen, s++; s != u; s++)
+				*a++ = (*s == Quest) ? Quest : untok(*s);
+			*a = '\0';
+			alen = a+1-ps->alts;
+			ps->nalts++;
+			last = -1;
+			}
+		else if (*s == '-' && last != -1 && s+1 != t)
+			{
+			for (t0 = last; t0 <= (unsigned char) untok(s[1]); t0++)
+				ps->map[t0 >> 3] |= 1 << (t0 & 7);
+			last = -1;
+			}
+		else
+			{
+			t0 = last = (unsigned char) untok(*s);
+			ps->map[t0 >> 3] |= 1 << (t0 & 7);
+			}
+		}
+	if (neg)
+		for (t0 = 0; t0 != 32; t0++)
+			ps->map[t0] = ~ps->map[t0];
+	ps->map[0] &= ~1;
+	pptr = t+1;
+	return nsets++;
+}
+
+/* add f2 to the end of f */
+
+static void join(struct pfrag *f,struct pfrag *f2)
+{
+	if (f2->start == -1)
+		return;
+	if (f->start == -1)
+		*f = *f2;
+	else
+		{
+		patch(f->out,f2->start);
+		f->out = f2->out;
+		}
+}
+
+/* parse a pattern up to a | or ) or the end */
+
+static int parsecomp(struct pfrag *f)
+{
+struct pfrag at;	/* the last piece, not joined on yet in case a # follows */
+int atom = 0;	/* != 0 if at matches a single character */
+int i;
+
+	f->start = at.start = -1;
 	while (*pptr && (mode || *pptr != '/') && *pptr != Bar &&
 			*pptr != Outpar)
 		{
-		if (*pptr == Hat)
+		if (*pptr == Pound)
+			{
+			if (!atom)
+				return 0;
+			closure(&at);
+			atom = 0;
+			continue;
+			}
+		join(f,&at);
+		at.start = -1;
+		atom = 0;
+		if (*pptr == Nularg)
+			pptr++;
+		else if (*pptr == Hat)	/* match if the rest does not */
 			{
-			*s++ = Hat;
-			*s++ = '\0';
 			pptr++;
-			if (!(c->nx1 = parsecomp()))
-				{
-				free(c->str);
-				free(c);
-				return NULL;
-				}
-			return c;
+			if (!parsecomp(&at))
+				return 0;
+			at.start = emit(P_NOT,at.start,0,0);
 			}
-		if (*pptr == Star && pptr[1] && (mode || pptr[1] != '/'))
+		else if (*pptr == Star && pptr[1] && (mode || pptr[1] != '/'))
+			{	/* * is ?# */
+			pptr++;
+			i = emit(P_SPLIT,plen+1,-1,0);
+			emit(P_ANY,i,0,0);
+			at.start = i;
+			at.out = 2*i+1;
+			}
+		else if (*pptr == Star)
 			{
-			*s++ = '\0';
 			pptr++;
-			c->nx1 = c1 = (comp) alloc(sizeof(struct xcomp));
-			*((c1->nx1 = c1)->str = strdup("?")) = Quest;
-			c->nx2 = c1->nx2 = parsecomp();
-			return (c->nx2) ? c : NULL;
+			at.start = emit(P_ANYREST,0,0,0);
+			at.out = -1;
 			}
-		if (*pptr == Inpar)
+		else if (*pptr == Inpar)
 			{
-			*s++ = '\0';
 			pptr++;
-			c->nx1 = c1 = parsecompsw();
+			if (!parsealt(&at))
+				return 0;
 			if (*pptr != Outpar)
 				{
 				errflag = 1;
-				free(c);
-				free(c->str);
-				return NULL;
+				return 0;
 				}
-			pptr++;
-			if (*pptr == Pound)
+			if (*++pptr == Pound)
+				closure(&at);
+			}
+		else
+			{
+			atom = 1;
+			if (*pptr == Inang)
 				{
-				int dpnd = 0;
+				char *s;
+				int dshct = (pptr[1] == Outang),lo = INT_MIN,hi = INT_MAX;
 
-				pptr++;
-				if (*pptr == Pound)
-					{
-					pptr++;
-					dpnd = 1;
-					}
-				c2 = parsecomp();
-				if (dpnd)
-					c->nx2 = NULL;
-				else
-					c->nx2 = c2;
-				if (!c2)
+				for (s = pptr+1; *s && *s != Outang; s++)
+					if (*s == '-')
+						dshct++;
+					else if (!isdigit(*s))
+						break;
+				if (*s != Outang || dshct != 1)
+					return 0;
+				if (s != pptr+1)
 					{
-					free(c);
-					free(c->str);
-					return NULL;
+					lo = zstrtol(pptr+1,&s,10);
+					if (!(hi = zstrtol(s+1,&s,10)))
+						hi = INT_MAX;
 					}
-				adjustcomp(c1,c2,c1);
-				return c;
+				pptr = s+1;
+				i = emit(P_NUM,-1,lo,hi);
 				}
-			c2 = parsecomp();
-			if (!c2)
+			else if (*pptr == Inbrack)
 				{
-				free(c);
-				free(c->str);
-				return NULL;
+				if ((i = parseset()) == -1)
+					return 0;
+				i = emit(P_SET,-1,i,0);
 				}
-			adjustcomp(c1,c2,NULL);
-			return c;
-			}
-		if (*pptr == Pound)
-			{
-			int dpnd = 0;
-
-			*s = '\0';
-			pptr++;
-			if (*pptr == Pound)
+			else if (*pptr == Quest)
 				{
 				pptr++;
-				dpnd = 1;
-				}
-			if (!ls)
-				return NULL;
-			c->nx1 = c1 = (comp) alloc(sizeof(struct xcomp));
-			(c1->nx2 = c1)->str = strdup(ls);
-			c->nx2 = c1->nx1 = parsecomp();
-			if (!c->nx2)
-				{
-				free(c);
-				free(c->str);
-				return NULL;
-				}
-			if (dpnd)
-				c->nx2 = NULL;
-			*ls++ = '\0';
-			return c;
-			}
-		ls = s;
-		if (*pptr == Inang)
-			{
-			int dshct;
-
-			dshct = (pptr[1] == Outang);
-			*s++ = *pptr++;
-			while (*pptr && (*s++ = *pptr++) != Outang)
-				if (s[-1] == '-')
-					dshct++;
-				else if (!isdigit(s[-1]))
-					break;
-			if (s[-1] != Outang || dshct != 1)
-				{
-				free(c);
-				free(c->str);
-				return NULL;
+				i = emit(P_ANY,-1,0,0);
 				}
-			}
-		else if (*pptr == Inbrack)
-			{
-			while (*pptr && (*s++ = *pptr++) != Outbrack);
-			if (s[-1] != Outbrack)
+			else
 				{
-				free(c);
-				free(c->str);
-				return NULL;
+				i = emit(P_CHAR,-1,untok(*pptr),0);
+				pptr++;
 				}
+			at.start = i;
+			at.out = 2*i;
 			}
-		else if (istok(*pptr) && *pptr != Star && *pptr != Quest)
-			*s++ = tokens[*pptr++-Pound];
-		else
-			*s++ = *pptr++;
 		}
-	*s++ = '\0';
-	c->nx1 = NULL;
-	return c;
+	join(f,&at);
+	if (f->start == -1)
+		{
+		f->start = emit(P_JMP,-1,0,0);
+		f->out = 2*f->start;
+		}
+	return 1;
 }
 
-comp parsecompsw(void)
+/* parse patterns separated by |s */
+
+static int parsealt(struct pfrag *f)
 {
-comp c1,c2,c3;
+struct pfrag f2;
 
-	c1 = parsecomp();
-	if (!c1)
-		return NULL;
-	if (*pptr == Bar)
+	if (!parsecomp(f))
+		return 0;
+	while (*pptr == Bar)
 		{
-		c2 = (comp) alloc(sizeof(struct xcomp));
 		pptr++;
-		c3 = parsecompsw();
-		if (!c3)
-			return NULL;
-		c2->str = strdup("");
-		c2->nx1 = c1;
-		c2->nx2 = c3;
-		return c2;
+		if (!parsecomp(&f2))
+			return 0;
+		f->start = emit(P_SPLIT,f->start,f2.start,0);
+		f->out = append(f->out,f2.out);
 		}
-	return c1;
+	return 1;
 }
 
-#define MARKER ((void *) 1L)
+/* free the [...]s of the pattern being compiled */
 
-void adjustcomp(comp c1,comp c2,comp c3)
+static void freesets(struct pset *ps,int ct)
 {
-comp z;
+	while (ct--)
+		if (ps[ct].alts)
+			free(ps[ct].alts);
+	if (ps)
+		free(ps);
+}
 
-	if (c1->nx1 == c2 && c1->nx2 == c3)
-		return;
-	if (c1->nx1)
-		{
-		if ((z = c1->nx1) == MARKER)
-			return;
-		c1->nx1 = MARKER;
-		adjustcomp(z,c2,c3);
-		c1->nx1 = z;
-		}
-	if (c1->nx2)
-		adjustcomp(c1->nx2,c2,c3);
-	if (!(c1->nx1 || c1->nx2))
+/* compile patterns separated by |s */
+
+comp parsecompsw(void)
+{
+struct pfrag f;
+comp c;
+int pc,t0;
+
+	plen = psize = nsets = ssize = 0;
+	prog = NULL;
+	psets = NULL;
+	if (!parsealt(&f))
 		{
-		c1->nx1 = c2;
-		c1->nx2 = c3;
+		freesets(psets,nsets);
+		if (prog)
+			free(prog);
+		return NULL;
 		}
+	patch(f.out,emit(P_MATCH,0,0,0));
+	c = (comp) alloc(sizeof(struct xcomp));
+	c->prog = prog;
+	c->ninst = plen;
+	c->sets = psets;
+	c->nsets = nsets;
+	c->start = f.start;
+	for (t0 = 0, pc = f.start; prog[pc].op != P_MATCH; pc = prog[pc].x)
+		if (prog[pc].op == P_CHAR)
+			t0++;
+		else if (prog[pc].op != P_JMP)
+			return c;
+	c->str = zalloc(t0+1);
+	for (t0 = 0, pc = f.start; prog[pc].op != P_MATCH; pc = prog[pc].x)
+		if (prog[pc].op == P_CHAR)
+			c->str[t0++] = prog[pc].y;
+	c->str[t0] = '\0';
+	return c;
 }
 
 void freepath(qath p)
@@ -1094,12 +1549,12 @@ void freepath(qath p)
 
 void freecomp(comp c)
 {
-	if (c && c->str)
+	if (c)
 		{
-		free(c->str);
-		c->str = NULL;
-		freecomp(c->nx1);
-		freecomp(c->nx2);
+		freesets(c->sets,c->nsets);
+		free(c->prog);
+		if (c->str)
+			free(c->str);
 		free(c);
 		}
 }
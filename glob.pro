@@ -1,6 +1,7 @@
 void glob(table list,Node *np);
 int notstrcmp(char **a,char **b);
-void insert(char *s);
+void insert(scan sc,int dfd,char *fn,int type);
+void addmatch(scan sc,char *s);
 int haswilds(char *str);
 int hasbraces(char *str);
 int xpandredir(struct fnode *fn,table tab);
@@ -10,16 +11,18 @@ void xpandbraces(table list,Node *np);
 char *getparen(char *str);
 int matchpat(char *a,char *b);
 void getmatch(char **sp,char *pat,int dd);
-void addpath(char *s);
-void scanner(qath q);
-int minimatch(char **pat,char **str);
+void addpath(scan s,char *str);
+void scanerr(int err,char *str);
+void scanner(scan s,qath q,int dfd);
+void pushwork(scan s,qath q);
+void *globthread(void *arg);
+int parpat(qath q);
+void parscan(scan s,qath q,int dfd);
 int doesmatch(char *str,comp c,int first);
 qath parsepat(char *str);
 comp parsereg(char *str);
 qath parseqath(void);
-comp parsecomp(void);
 comp parsecompsw(void);
-void adjustcomp(comp c1,comp c2,comp c3);
 void freepath(qath p);
 void freecomp(comp c);
 int patmatch(char *ss,char *tt);
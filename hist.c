@@ -31,9 +31,14 @@
 
 #include "zsh.h"
 #include "funcs.h"
+#include <sys/errno.h>
 
 int lastc;
 
+/* != 0 if the last character hgetch() returned was put back */
+
+static int fromungots;
+
 /* add a character to the current history word */
 
 void hwaddc(int c)
@@ -68,10 +73,10 @@ tailrec:
 		hwaddc(c);
 		return c;
 		}
-	if (firstch && c == '^' && !(ungots && !magic))
+	if (firstch && c == '^' && !(fromungots && !magic))
 		{
 		firstch = 0;
-		hungets(strdup(":s^"));
+		hungets(":s^");
 		c = '!';
 		goto hatskip;
 		}
@@ -89,7 +94,7 @@ tailrec:
 			return '!';
 			}
 		}
-	if (c != '!' || (ungots && !magic))
+	if (c != '!' || (fromungots && !magic))
 		{
 		hwaddc(c);
 		return c;
@@ -339,7 +344,8 @@ hatskip:
 	
 	/* stuff the resulting string in the input queue and start over */
 
-	hungets(makehlist(slist,1));
+	hungets(ptr = makehlist(slist,1));
+	free(ptr);
 	hflag |= 1;
 	goto tailrec;
 }
@@ -358,19 +364,23 @@ void strinend(void)
 	strin = 0;
 	firstch = 1;
 	hflag = 0;
-	free(ungots);
-	ungotptr = ungots = NULL;
+	hflush();
 	peek = EMPTY;
 }
 
-static char *line = NULL,*oline = NULL;
+/* the line being read; oline is the storage to free, if any.
+	lnct is the # of characters just read from the line, which can
+	be put back by moving line */
+
+static char *line = NULL,*oline = NULL,*lend = NULL;
+static int lnct;
 
 /* stuff a whole FILE into the input queue */
 
 int stuff(char *fn)
 {
 FILE *in;
-char *buf;
+char *buf,*sav;
 int len;
 
 	if (!(in = fopen(fn,"r")))
@@ -394,10 +404,16 @@ int len;
 		line = oline = buf;
 	else
 		{
-		line = dyncat(line,buf);
-		free(oline);
-		oline = line;
+		sav = zalloc((lend-line)+len+1);
+		memcpy(sav,line,lend-line);
+		strcpy(sav+(lend-line),buf);
+		free(buf);
+		if (oline)
+			free(oline);
+		line = oline = sav;
 		}
+	lend = line+strlen(line);
+	lnct = 0;
 	return 0;
 }
 
@@ -407,47 +423,45 @@ int hgetch(void)
 {
 char *pmpt = NULL,*s;
 
-	if (ungots)
+	if (ungotct)
 		{
-		if (*ungotptr)
+		if (ungots[--ungotct] == ALPOP)	/* done expanding an alias,
+														pop the alias stack */
 			{
-			if (*ungotptr == ALPOP)	/* done expanding an alias,
-												pop the alias stack */
-				{
-				if (!alix)
-					{
-					ungotptr++;
-					return lastc = HERR;
-					}
-				alstack[--alix]->inuse = 0;
-				s = alstack[alix]->text;
-				if (*s && s[strlen(s)-1] == ' ')
-					alstat = ALSTAT_MORE;
-				else
-					alstat = ALSTAT_JUNK;
-				ungotptr++;
-				return lastc = hgetch();
-				}
-			return lastc = *ungotptr++;
+			if (!alix)
+				return lastc = HERR;
+			alstack[--alix]->inuse = 0;
+			s = alstack[alix]->text;
+			if (*s && s[strlen(s)-1] == ' ')
+				alstat = ALSTAT_MORE;
+			else
+				alstat = ALSTAT_JUNK;
+			return lastc = hgetch();
 			}
-		if (strin)
-			return lastc = EOF;
-		ungotptr = 0;
-		free(ungots);
-		ungots = NULL;
+		fromungots = 1;
+		lnct = 0;
+		return lastc = ungots[ungotct];
 		}
+	fromungots = 0;
+	if (strin)
+		return lastc = EOF;
 kludge:
 	if (errflag)
 		{
 		if (oline)
 			free(oline);
 		oline = line = NULL;
+		lnct = 0;
 		return lastc = HERR;
 		}
-	if (line && *line)
+	if (line && line < lend)
+		{
+		lnct++;
 		return lastc = (*line++);
-	if (line)
+		}
+	if (oline)
 		free(oline);
+	oline = line = NULL;
 	if (interact)
 		if (!firstln)
 			pmpt = putprompt("PROMPT2");
@@ -455,29 +469,127 @@ kludge:
 			pmpt = putprompt("PROMPT");
 	if (interact && SHTTY == -1)
 		write(2,pmpt,strlen(pmpt));
-	oline = line = (interact && SHTTY != -1) ? readline(pmpt) : 
-		fgets(zalloc(256),256,bshin);
-	if (isset(VERBOSE) && line)
-		fputs(line,stderr);
+	if (interact && SHTTY != -1)
+		{
+		if (oline = line = readline(pmpt))
+			lend = line+strlen(line);
+		}
+	else
+		line = ingetline(bshin,&lend);	/* read in place */
+	lnct = 0;
 	if (!line)
 		return lastc = EOF;
-	if (line[strlen(line)-1] == '\n')
+	if (isset(VERBOSE))
+		fwrite(line,1,lend-line,stderr);
+	if (lend > line && lend[-1] == '\n')
 		lineno++;
 	firstch = 1;
 	firstln = 0;
 	goto kludge;
 }
 
+/* get an input buffer for fd */
+
+struct inbuf *inopen(int fd)
+{
+struct inbuf *in = alloc(sizeof *in);
+
+	in->fd = fd;
+	in->siz = (fd) ? INBUFSIZ : BUFSIZ;	/* fd 0 may be shared with commands,
+														so don't read too far ahead of them */
+	in->ptr = in->end = in->buf = zalloc(in->siz);
+	return in;
+}
+
+/* close an input buffer and its fd */
+
+void inclose(struct inbuf *in)
+{
+	if (line >= in->buf && line <= in->buf+in->siz)
+		{
+		line = lend = NULL;
+		lnct = 0;
+		}
+	close(in->fd);
+	free(in->buf);
+	free(in);
+}
+
+/* get the next line from an input buffer, returning a pointer to it
+	in the buffer and setting *ep to its end; it stays valid until
+	the next call */
+
+char *ingetline(struct inbuf *in,char **ep)
+{
+char *s;
+int n;
+
+	FOREVER
+		{
+		if (s = memchr(in->ptr,'\n',in->end-in->ptr))
+			break;
+		if (in->eof)
+			{
+			if (in->ptr == in->end)
+				return NULL;
+			s = in->end-1;		/* last line has no newline */
+			break;
+			}
+		if (in->ptr != in->buf)
+			{
+			memmove(in->buf,in->ptr,in->end-in->ptr);
+			in->end -= in->ptr-in->buf;
+			in->ptr = in->buf;
+			}
+		if (in->end == in->buf+in->siz)
+			{
+			n = in->end-in->buf;
+			in->buf = realloc(in->buf,in->siz *= 2);
+			in->ptr = in->buf;
+			in->end = in->buf+n;
+			}
+		if ((n = read(in->fd,in->end,in->buf+in->siz-in->end)) > 0)
+			in->end += n;
+		else if (n == 0 || errno != EINTR)
+			in->eof = 1;
+		}
+	*ep = ++s;
+	s = in->ptr;
+	in->ptr = *ep;
+	return s;
+}
+
+/* get a copy of the next line from an input buffer */
+
+char *ingets(struct inbuf *in)
+{
+char *s,*e,*r;
+
+	if (!(s = ingetline(in,&e)))
+		return NULL;
+	r = zalloc(e-s+1);
+	memcpy(r,s,e-s);
+	r[e-s] = '\0';
+	return r;
+}
+
 /* unget a character */
 
 void hungetch(int c)
 {
-static char ubuf2[] = {'x',0};
-
 	if (c == EOF)
 		return;
-	ubuf2[0] = c;
-	hungets(strdup(ubuf2));
+	if (lnct && !ungotct && line[-1] == c &&
+			c != '!' && c != '^')
+		{
+		lnct--;
+		line--;		/* just read from the line; back up over it.  ! and ^
+							must come from ungots so they aren't expanded again */
+		return;
+		}
+	if (ungotct == ungotsiz)
+		growungots(1);
+	ungots[ungotct++] = c;
 }
 
 /* unget a character and remove it from the history word */
@@ -496,31 +608,44 @@ void hungetc(int c)
 
 void hflush(void)
 {
-	if (ungots)
+	if (ungots != ungotbuf)
+		{
 		free(ungots);
-	ungots = ungotptr = NULL;
+		ungots = ungotbuf;
+		ungotsiz = UNGOTSIZ;
+		}
+	ungotct = 0;
 }
 
-/* unget a string into the input queue */
+/* unget a string into the input queue; it is copied */
 
 void hungets(char *str)
 {
-	if (ungots && !*ungotptr)
-		{
-		free(ungots);
-		ungots = NULL;
-		}
-	if (ungots)
+char *s = str+strlen(str);
+
+	if (ungotct+(s-str) > ungotsiz)
+		growungots(s-str);
+	while (s != str)
+		ungots[ungotct++] = *--s;
+}
+
+/* make room for n more characters on the pushback stack; only long
+	strings such as big aliases get this far */
+
+void growungots(int n)
+{
+char *s;
+
+	while (ungotct+n > ungotsiz)
+		ungotsiz *= 2;
+	if (ungots == ungotbuf)
 		{
-		char *ptr;
-		
-		ptr = dyncat(str,ungotptr);
-		free(ungots);
-		free(str);
-		ungotptr = ungots = ptr;
+		s = zalloc(ungotsiz);
+		memcpy(s,ungotbuf,ungotct);
+		ungots = s;
 		}
 	else
-		ungots = ungotptr = str;
+		ungots = realloc(ungots,ungotsiz);
 }
 
 /* initialize the history mechanism */
@@ -4,10 +4,15 @@ void strinbeg(void);
 void strinend(void);
 int stuff(char *fn);
 int hgetch(void);
+struct inbuf *inopen(int fd);
+void inclose(struct inbuf *in);
+char *ingetline(struct inbuf *in,char **ep);
+char *ingets(struct inbuf *in);
 void hungetch(int c);
 void hungetc(int c);
 void hflush(void);
 void hungets(char *str);
+void growungots(int n);
 void hbegin(void);
 void inittty(void);
 int hend(void);
@@ -68,6 +68,7 @@ int notect = 0;
 void loop(void)
 {
 list list;
+struct arena *ar,*oar = parena;
 
 	FOREVER
 		{
@@ -77,8 +78,13 @@ list list;
 		hbegin();		/* init history mech */
 		intr();			/* interrupts on */
 		ainit();			/* init alias mech */
-		if (!(list = parlist1(0)))
+		parsebytes = parsenodes = 0;
+		parena = ar = newarena();	/* the tree lives until it is run */
+		list = (zwcin) ? zwcnext(ar) : parlist1(0);
+		parena = oar;
+		if (!list)
 			{				/* if we couldn't parse a list */
+			freearena(ar);
 			hend();
 			if (!errflag)
 				if (peek == OUTPAR)
@@ -115,8 +121,11 @@ list list;
 			{
 			if (stopmsg)		/* unset 'you have stopped jobs' flag */
 				stopmsg--;
+			if (!list->prog)
+				compile(list,ar);
 			execlist(list);
 			}
+		freearena(ar);
 		if (ferror(stderr))
 			{
 			zerr("write error");
@@ -147,7 +156,7 @@ int c;
 	opts['i'] = (isatty(0)) ? OPT_SET : OPT_UNSET;
 	for (c = '0'; c <= '9'; c++)
 		opts[c] = OPT_UNSET;
-	for (c = 'A'; c <= 'K'; c++)
+	for (c = 'A'; c <= 'L'; c++)
 		opts[c] = OPT_UNSET;
 	opts[BGNICE] = opts[NOTIFY] = OPT_SET;
 }
@@ -194,6 +203,7 @@ int bk = 0;
 		if (opts[SHINSTDIN] == OPT_UNSET)
 			{
 			SHIN = movefd(open(argv0 = *argv,O_RDONLY));
+			scriptname = argv0;
 			if (SHIN == -1)
 				{
 				zerr("can't open input file: %s",*argv);
@@ -243,6 +253,7 @@ char *ptr;
 	alhtab = newhtable(37);
 	parmhtab = newhtable(17);
 	shfunchtab = newhtable(17);
+	growjobtab();
 	if (interact)
 		{
 		if (!getparm("PROMPT"))
@@ -292,14 +303,14 @@ int t0;
 	tevs = DEFAULT_HISTSIZE;
 	histlist = newtable();
 	dirstack = newtable();
-	ungots = ungotptr = NULL;
 	signal(SIGQUIT,SIG_IGN);
 	for (t0 = 0; t0 != RLIM_NLIMITS; t0++)
 		getrlimit(t0,limits+t0);
 	last = rast = NULL;
 	proclast = 0;
 	if (!interact || SHTTY == -1)
-		bshin = fdopen(SHIN,"r");
+		bshin = inopen(SHIN);
+	mksigfds();
 	signal(SIGCHLD,handler);
 	addreswords();
 	addhnode(strdup("false"),mkanode(strdup("let 0"),1),alhtab,NULL);
@@ -361,6 +372,7 @@ void runscripts(void)
 		close(SHIN);
 		SHIN = movefd(open("/dev/null",O_RDONLY));
 		hungets(cmd);
+		free(cmd);
 		strinbeg();
 		}
 }
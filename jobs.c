@@ -43,6 +43,35 @@ static int handling = 0;
 
 static int waiting = 0;
 
+/* a bit for each entry of the job table, set if the entry is in
+	use, so that getfreejob() can pass over a word of them at a time.
+	Entry 0 isn't used, so its bit is always set. */
+
+#define JOBBITS (sizeof(unsigned long)*8)
+#define JOBWORDS(n) (((n)+JOBBITS-1)/JOBBITS)
+
+static unsigned long *jobused;
+
+/* the lowest word of jobused that may have a free entry; the ones
+	below it are all full */
+
+static int lowfree = 0;
+
+/* hash table of the processes in the job table, by pid */
+
+static struct procnode **pidtab;
+static int pidtabsiz = 0,pidct = 0;
+
+/* != 0 means the handler has written to the self-pipe */
+
+static volatile int pendsigs = 0;
+
+/* background jobs that have finished and not been waited for,
+	oldest first */
+
+static table deadjobs = NULL;
+static int deadct = 0;
+
 /* != 0 means readline is active */
 
 extern int rl_active;
@@ -57,57 +86,126 @@ extern int rl_waiting;
 #define RETURN return
 #endif
 
-/* the signal handler */
+/* the signal handler.  Apart from an untrapped SIGINT, which just
+	sets errflag, it only writes the signal number down the self-pipe;
+	the work is done later by handlesigs(). */
 
 HANDTYPE handler(int sig,int code)
 {
-long pid;
-int statusp;
-struct jobnode *jn;
-struct procnode *pn;
-struct rusage ru;
+char c = sig;
+int e = errno;
 
-	if (sig == SIGINT)
+	if (sig == SIGINT && !sigtrapped[SIGINT])
 		{
-		if (sigtrapped[SIGINT])
-			dotrap(SIGINT);
-		else
-			errflag = 1;
+		errflag = 1;
 		RETURN;
 		}
-	if (sig != SIGCHLD)
+	pendsigs = 1;
+	write(sigfds[1],&c,1);
+	errno = e;
+	RETURN;
+}
+
+/* make the self-pipe, or a new one for a subshell so that it doesn't
+	read its parent's signals */
+
+void mksigfds(void)
+{
+int t0;
+
+	if (sigfds[0] != -1)
 		{
-		dotrap(sig);
-		RETURN;
+		close(sigfds[0]);
+		close(sigfds[1]);
 		}
-	for (;;)
+	if (pipe(sigfds) == -1)
 		{
-		pid = wait3(&statusp,WNOHANG|WUNTRACED,&ru);
-		if (pid == -1)
-			{
-			if (errno != ECHILD)
-				zerr("%e",errno);
-			RETURN;
-			}
-		if (!pid)
-			RETURN;
-		findproc(pid,&jn,&pn);	/* find the procnode of this pid */
-		if (jn)
+		zerr("can't make signal pipe: %e",errno);
+		exit(1);
+		}
+	for (t0 = 0; t0 != 2; t0++)
+		{
+		sigfds[t0] = movefd(sigfds[t0]);
+		fcntl(sigfds[t0],F_SETFL,O_NONBLOCK);
+		}
+	pendsigs = 0;
+}
+
+/* deal with the signals queued by the handler: reap all the children
+	that have changed state at once, and run the traps.  Returns
+	nonzero if a trapped SIGINT came in. */
+
+int handlesigs(void)
+{
+unsigned char buf[64],got[NSIG];
+int n,t0;
+
+	if (!pendsigs)
+		return 0;
+	pendsigs = 0;
+	memset(got,0,sizeof got);
+	while ((n = read(sigfds[0],buf,sizeof buf)) > 0)
+		for (t0 = 0; t0 != n; t0++)
+			got[buf[t0]] = 1;
+	if (got[SIGCHLD])
+		reap();
+	for (t0 = 1; t0 != SIGCOUNT; t0++)
+		if (got[t0] && t0 != SIGCHLD)
+			dotrap(t0);
+	return got[SIGINT];
+}
+
+/* wait for a signal to come in, and deal with it */
+
+void waitsig(void)
+{
+fd_set fds;
+int mask;
+
+	mask = sigsetmask(0);
+	if (!pendsigs)
+		{
+		FD_ZERO(&fds);
+		FD_SET(sigfds[0],&fds);
+		select(sigfds[0]+1,&fds,NULL,NULL,NULL);
+		}
+	sigsetmask(mask);
+	handlesigs();
+}
+
+/* collect the status of every child that has exited or stopped */
+
+void reap(void)
+{
+long pid;
+int statusp;
+struct jobnode *jn;
+struct procnode *pn;
+struct rusage ru;
+
+	while ((pid = wait3(&statusp,WNOHANG|WUNTRACED,&ru)) > 0)
+		if (pn = findproc(pid))	/* find the procnode of this pid */
 			{
+			jn = jobtab+pn->job;
 			pn->statusp = statusp;
 			handling = 1;
-			pn->ru_utime = ru.ru_utime;
-			pn->ru_stime = ru.ru_stime;
+			pn->ru = ru;
 			pn->endtime = time(NULL);
+			if (pn->trace && !WIFSTOPPED(SP(statusp)))
+				{
+				traceend(pn->trace,pn->tstart,pid,(WIFSIGNALED(SP(statusp))) ?
+					0200|WTERMSIG(SP(statusp)) : WEXITSTATUS(SP(statusp)));
+				pn->trace = NULL;
+				}
 			updatestatus(jn);
 			handling = 0;
 			}
 		else if (WIFSTOPPED(SP(statusp)))
 			kill(pid,SIGKILL);	/* kill stopped untraced children */
-		}
+	if (pid == -1 && errno != ECHILD)
+		zerr("%e",errno);
 	if (rl_active)
 		rl_prep_terminal();
-	RETURN;
 }
 
 /* change job table entry from stopped to running */
@@ -147,6 +245,8 @@ int notrunning = 1,alldone = 1,val,job = jn-jobtab,somestopped = 0;
 		return;
 	jn->stat |= (alldone) ? STAT_CHANGED|STAT_DONE :
 		STAT_CHANGED|STAT_STOPPED;
+	if (alldone)
+		jn->val = val;
 	if (!alldone)
 		gettyinfo(&jn->ttyinfo);
 	if (job == curjob)
@@ -162,29 +262,72 @@ int notrunning = 1,alldone = 1,val,job = jn-jobtab,somestopped = 0;
 		prevjob = topjob;
 		topjob = job;
 		}
+	else if (job != curjob && !(jn->stat & STAT_NOTOURS))
+		{
+		for (pn = jn->procs; pn->next; pn = pn->next);
+		adddead(job,pn->pid,val);
+		}
 	if ((isset(NOTIFY) || job == curjob) && jn->stat & STAT_LOCKED)
 		printjob(jn,0);
 	if (sigtrapped[SIGCHLD] && job != curjob)
 		dotrap(SIGCHLD);
 }
 
-/* find procnode and jobnode associated with pid */
+/* find the procnode of a pid */
 
-void findproc(int pid,struct jobnode **jptr,struct procnode **pptr)
+struct procnode *findproc(long pid)
 {
 struct procnode *pn;
-int jn;
 
-	for (jn = 1; jn != MAXJOB; jn++)
-		for (pn = jobtab[jn].procs; pn; pn = pn->next)
-			if (pn->pid == pid)
+	if (!pidtabsiz)
+		return NULL;
+	for (pn = pidtab[pid & (pidtabsiz-1)]; pn; pn = pn->hchain)
+		if (pn->pid == pid)
+			return pn;
+	return NULL;
+}
+
+/* add a procnode to pidtab, doubling the table when it gets full */
+
+void hashproc(struct procnode *pn)
+{
+struct procnode **ptr,**optab = pidtab,*p,*next;
+int t0,osiz = pidtabsiz;
+
+	if (pidct >= pidtabsiz)
+		{
+		pidtabsiz = (pidtabsiz) ? pidtabsiz*2 : 64;
+		pidtab = alloc(pidtabsiz*sizeof *pidtab);
+		for (t0 = 0; t0 != osiz; t0++)
+			for (p = optab[t0]; p; p = next)
 				{
-				*pptr = pn;
-				*jptr = jobtab+jn;
-				return;
+				next = p->hchain;
+				ptr = &pidtab[p->pid & (pidtabsiz-1)];
+				p->hchain = *ptr;
+				*ptr = p;
 				}
-	*pptr = NULL;
-	*jptr = NULL;
+		if (optab)
+			free(optab);
+		}
+	ptr = &pidtab[pn->pid & (pidtabsiz-1)];
+	pn->hchain = *ptr;
+	*ptr = pn;
+	pidct++;
+}
+
+/* remove a procnode from pidtab */
+
+void unhashproc(struct procnode *pn)
+{
+struct procnode **ptr = &pidtab[pn->pid & (pidtabsiz-1)];
+
+	for (; *ptr; ptr = &(*ptr)->hchain)
+		if (*ptr == pn)
+			{
+			*ptr = pn->hchain;
+			pidct--;
+			return;
+			}
 }
 
 static char *sigmsg[32] = {
@@ -258,7 +401,7 @@ extern void rl_on_new_line(void);
 			job != curjob))
 		{
 		int len2,fline = 1;
-		struct procnode *qn;
+		struct procnode *qn,*rp;
 
 		if (handling && (!waiting || jn->stat & STAT_STOPPED))
 			putc('\n',stderr);
@@ -310,8 +453,12 @@ extern void rl_on_new_line(void);
 					len-14+2-strlen(sigmsg[WTERMSIG(SP(pn->statusp))]),"");
 			else
 				fprintf(stderr,"%-*s",len+2,sigmsg[WTERMSIG(SP(pn->statusp))]);
+			rp = pn;
 			for (; pn != qn; pn = pn->next)
 				fprintf(stderr,(pn->next) ? "%s | " : "%s",pn->text);
+			if (lng == 1 && rp->statusp != SP_RUNNING &&
+					!WIFSTOPPED(SP(rp->statusp)))
+				printrusage(&rp->ru);
 			putc('\n',stderr);
 			fline = 0;
 			}
@@ -332,33 +479,12 @@ extern void rl_on_new_line(void);
 
 	if (jn->stat & STAT_DONE)
 		{
-		static struct jobnode zero;
-		struct procnode *nx;
-		char *s;
-
 		if (jn->stat & STAT_TIMED)
 			{
 			dumptime(jn);
 			printed = 1;
 			}
-		for (pn = jn->procs; pn; pn = nx)
-			{
-			nx = pn->next;
-			if (pn->text)
-				free(pn->text);
-			free(pn);
-			}
-		free(jn->cwd);
-		if (jn->filelist)
-			{
-			while (s = getnode(jn->filelist))
-				{
-				unlink(s);
-				free(s);
-				}
-			free(jn->filelist);
-			}
-		*jn = zero;
+		deletejob(job);
 		if (job == topjob)
 			{
 			topjob = prevjob;
@@ -383,12 +509,12 @@ void setprevjob(void)
 {
 int t0;
 
-	for (t0 = MAXJOB-1; t0; t0--)
+	for (t0 = maxjob-1; t0; t0--)
 		if (jobtab[t0].stat && jobtab[t0].stat & STAT_STOPPED &&
 				t0 != topjob && t0 != curjob)
 			break;
 	if (!t0)
-		for (t0 = MAXJOB-1; t0; t0--)
+		for (t0 = maxjob-1; t0; t0--)
 			if (jobtab[t0].stat && t0 != topjob && t0 != curjob)
 				break;
 	prevjob = (t0) ? t0 : -1;
@@ -415,6 +541,7 @@ struct procnode *procnode;
 	proclast = pid;
 	procnode = alloc(sizeof(struct procnode));
 	procnode->pid = pid;
+	procnode->job = curjob;
 	procnode->text = text;
 	procnode->next = NULL;
 	procnode->statusp = SP_RUNNING;
@@ -429,6 +556,7 @@ struct procnode *procnode;
 		}
 	else
 		jobtab[curjob].procs = procnode;
+	hashproc(procnode);
 	return procnode;
 }
 
@@ -442,30 +570,16 @@ struct jobnode *jn;
 
 	if (!exiting)
 		return 0;
-	for (jn = jobtab+1; jn != jobtab+MAXJOB; jn++)
+	for (jn = jobtab+1; jn != jobtab+maxjob; jn++)
 		if (jn->stat && jn->filelist)
 			return 0;
 	return 1;
 }
 
-/* wait for a SIGCHLD, wait for the handler to execute, and return */
-
-void chldsuspend(void)
-{
-struct sigvec vec = { handler,sigmask(SIGCHLD),SV_INTERRUPT };
-
-	sigvec(SIGCHLD,&vec,NULL);
-	sigpause(0);
-	signal(SIGCHLD,handler);
-}
-
 /* wait for the current job to finish */
 
 void waitjobs(void)
 {
-static struct jobnode zero;
-struct jobnode *jn;
-
 	if (jobtab[curjob].procs)	/* if any forks were done */
 		{
 		jobtab[curjob].stat |= STAT_LOCKED;
@@ -474,59 +588,194 @@ struct jobnode *jn;
 			printjob(jobtab+curjob,0);
 		while (jobtab[curjob].stat &&
 				!(jobtab[curjob].stat & (STAT_DONE|STAT_STOPPED)))
-			chldsuspend();
+			waitsig();
 		waiting = 0;
 		}
 	else	/* else do what printjob() usually does */
-		{
-		char *s;
+		deletejob(curjob);
+	curjob = -1;
+}
+
+/* clear jobtab when entering subshells */
 
-		jn = jobtab+curjob;
-		free(jn->cwd);
-		if (jn->filelist)
+void clearjobtab(void)
+{
+int t0;
+
+	if (curjob > 0)
+		freejob(curjob);
+	for (t0 = 1; t0 != maxjob; t0++)
+		if (jobtab[t0].stat)
+			jobtab[t0].stat |= STAT_NOTOURS;
+	if (deadjobs)
+		while (deadct)
 			{
-			while (s = getnode(jn->filelist))
-				{
-				unlink(s);
-				free(s);
-				}
-			free(jn->filelist);
+			free(getnode(deadjobs));
+			deadct--;
 			}
-		*jn = zero;
+}
+
+/* make the job table twice as big (or create it).  Entry 0
+	isn't used. */
+
+void growjobtab(void)
+{
+int osize = maxjob;
+
+	maxjob = (maxjob) ? maxjob*2 : JOBTABSIZ;
+	if (!(jobtab = realloc(jobtab,maxjob*sizeof *jobtab)))
+		{
+		zerr("fatal error: out of memory");
+		exit(1);
 		}
-	curjob = -1;
+	memset(jobtab+osize,0,(maxjob-osize)*sizeof *jobtab);
+	if (!(jobused = realloc(jobused,JOBWORDS(maxjob)*sizeof *jobused)))
+		{
+		zerr("fatal error: out of memory");
+		exit(1);
+		}
+	memset(jobused+JOBWORDS(osize),0,
+		(JOBWORDS(maxjob)-JOBWORDS(osize))*sizeof *jobused);
+	jobused[0] |= 1;
 }
 
-/* clear jobtab when entering subshells */
+/* clear a job table entry, freeing its procnodes */
 
-void clearjobtab(void)
+void freejob(int job)
 {
 static struct jobnode zero;
+struct procnode *pn,*next;
 int t0;
 
-	for (t0 = 1; t0 != MAXJOB; t0++)
-		jobtab[curjob] = zero;
+	for (pn = jobtab[job].procs; pn; pn = next)
+		{
+		next = pn->next;
+		unhashproc(pn);
+		if (pn->text)
+			free(pn->text);
+		if (pn->trace)
+			free(pn->trace);
+		free(pn);
+		}
+	t0 = jobtab[job].gen;
+	jobtab[job] = zero;
+	jobtab[job].gen = t0;
+	jobused[job/JOBBITS] &= ~(1UL << job%JOBBITS);
+	if (job/JOBBITS < lowfree)
+		lowfree = job/JOBBITS;
 }
 
-/* get a free entry in the job table to use */
+/* delete a finished job, and the files it left behind */
 
-int getfreejob(void)
+void deletejob(int job)
 {
-int mask,t0;
+struct jobnode *jn = jobtab+job;
+char *s;
 
-	FOREVER	
+	free(jn->cwd);
+	if (jn->filelist)
 		{
-		mask = sigblock(sigmask(SIGCHLD));
-		for (t0 = 1; t0 != MAXJOB; t0++)
-			if (!jobtab[t0].stat)
-				{
-				sigsetmask(mask);
-				jobtab[t0].stat |= STAT_INUSE;
-				return t0;
-				}
-		sigsetmask(mask);
-		sleep(1);
+		while (s = getnode(jn->filelist))
+			{
+			unlink(s);
+			free(s);
+			}
+		free(jn->filelist);
 		}
+	freejob(job);
+}
+
+/* remember the status of a background job that has finished */
+
+void adddead(int job,long pid,int stat)
+{
+struct deadjob *dj;
+
+	if (!deadjobs)
+		deadjobs = newtable();
+	if (deadct == MAXDEAD)
+		{
+		free(getnode(deadjobs));
+		deadct--;
+		}
+	dj = alloc(sizeof *dj);
+	dj->job = job;
+	dj->pid = pid;
+	dj->stat = stat;
+	dj->gen = ++jobtab[job].gen;
+	addnode(deadjobs,dj);
+	deadct++;
+}
+
+/* take a finished job off the dead list: the latest with the given
+	job number or pid, or if both are 0 the oldest one.  A job number
+	only finds the last job with that number to finish, not one that
+	had the number before it. */
+
+struct deadjob *getdead(int job,long pid)
+{
+Node n,found = NULL;
+struct deadjob *dj;
+
+	if (!deadct)
+		return NULL;
+	for (n = deadjobs->first; n; n = n->next)
+		{
+		dj = n->dat;
+		if (!job && !pid)
+			{
+			found = n;
+			break;
+			}
+		if ((job && dj->job == job && dj->gen == jobtab[job].gen) ||
+				(pid && dj->pid == pid))
+			found = n;
+		}
+	if (!found)
+		return NULL;
+	deadct--;
+	return remnode(deadjobs,found);
+}
+
+/* != 0 if a job of ours is running in the background; if job is 0,
+	if any is */
+
+int bgrunning(int job)
+{
+int t0;
+
+	if (job)
+		return job > 0 && job < maxjob && job != curjob && jobtab[job].stat &&
+			!(jobtab[job].stat & (STAT_DONE|STAT_STOPPED|STAT_NOTOURS));
+	for (t0 = 1; t0 != maxjob; t0++)
+		if (bgrunning(t0))
+			return 1;
+	return 0;
+}
+
+/* get the lowest free entry in the job table to use, so that job
+	numbers stay small */
+
+int getfreejob(void)
+{
+int mask,t0,w;
+
+	mask = sigblock(sigmask(SIGCHLD));
+	for (w = lowfree; w != JOBWORDS(maxjob) && jobused[w] == ~0UL; w++);
+	t0 = w*JOBBITS;
+	if (w != JOBWORDS(maxjob))
+		while (jobused[w] & (1UL << t0%JOBBITS))
+			t0++;
+	if (t0 >= maxjob)
+		{
+		t0 = maxjob;
+		growjobtab();
+		}
+	jobused[t0/JOBBITS] |= 1UL << t0%JOBBITS;
+	lowfree = t0/JOBBITS;
+	jobtab[t0].stat |= STAT_INUSE;
+	sigsetmask(mask);
+	return t0;
 }
 
 /* print pids for & */
@@ -569,37 +818,77 @@ static void addtimeval(struct timeval *s,struct timeval *t)
 	s->tv_usec = (s->tv_usec+t->tv_usec)%1000000;
 }
 
-static void printtime(time_t real,struct timeval *u,struct timeval *s,char *desc)
+/* add the usage of one process to a total; the memory used is the
+	most any of them used */
+
+static void addrusage(struct rusage *s,struct rusage *t)
+{
+	addtimeval(&s->ru_utime,&t->ru_utime);
+	addtimeval(&s->ru_stime,&t->ru_stime);
+	if (t->ru_maxrss > s->ru_maxrss)
+		s->ru_maxrss = t->ru_maxrss;
+	s->ru_majflt += t->ru_majflt;
+	s->ru_minflt += t->ru_minflt;
+	s->ru_nvcsw += t->ru_nvcsw;
+	s->ru_nivcsw += t->ru_nivcsw;
+	s->ru_inblock += t->ru_inblock;
+	s->ru_oublock += t->ru_oublock;
+}
+
+static void printtime(time_t real,struct rusage *ru,char *desc)
 {
 	if (!desc)
 		desc = "";
 	fprintf(stderr,"real: %lds  user: %ld.%03lds  sys: %ld.%03lds\n",
-		real,u->tv_sec,u->tv_usec/1000,s->tv_sec,s->tv_usec/1000);
+		(long) real,(long) ru->ru_utime.tv_sec,
+		(long) ru->ru_utime.tv_usec/1000,(long) ru->ru_stime.tv_sec,
+		(long) ru->ru_stime.tv_usec/1000);
+	fprintf(stderr,"mem: %ldk  faults: %ld major %ld minor  "
+		"switches: %ld vol %ld invol  blocks: %ld in %ld out\n",
+		ru->ru_maxrss,ru->ru_majflt,ru->ru_minflt,ru->ru_nvcsw,ru->ru_nivcsw,
+		ru->ru_inblock,ru->ru_oublock);
 }
 
 static void printheader(void)
 {
-	fprintf(stderr,"  real       user      system\n");
+	fprintf(stderr,"  real       user      system    maxrss  majflt  minflt"
+		"   nvcsw  nivcsw   inblk   oublk\n");
 }
 
-static void printtimes(time_t real,struct timeval *u,struct timeval *s,char *desc)
+static void printtimes(time_t real,struct rusage *ru,char *desc)
 {
 	if (!desc)
 		desc = "";
-	fprintf(stderr,"% 8lds  % 4d.%03lds  % 4d.%03lds  %s\n",
-		real,u->tv_sec,u->tv_usec/1000,s->tv_sec,s->tv_usec/1000,desc);
+	fprintf(stderr,"% 8lds  %4ld.%03lds  %4ld.%03lds  % 7ldk % 7ld % 7ld"
+		" % 7ld % 7ld % 7ld % 7ld  %s\n",
+		(long) real,(long) ru->ru_utime.tv_sec,
+		(long) ru->ru_utime.tv_usec/1000,(long) ru->ru_stime.tv_sec,
+		(long) ru->ru_stime.tv_usec/1000,ru->ru_maxrss,
+		ru->ru_majflt,ru->ru_minflt,ru->ru_nvcsw,ru->ru_nivcsw,
+		ru->ru_inblock,ru->ru_oublock,desc);
+}
+
+/* print the resource usage of a process that has exited, for
+	jobs -l */
+
+void printrusage(struct rusage *ru)
+{
+	fprintf(stderr,"  (%ldk, %ld+%ld faults, %ld+%ld switches, %ld+%ld blocks)",
+		ru->ru_maxrss,ru->ru_majflt,ru->ru_minflt,ru->ru_nvcsw,ru->ru_nivcsw,
+		ru->ru_inblock,ru->ru_oublock);
 }
 
 void dumptime(struct jobnode *jn)
 {
 struct procnode *pn = jn->procs;
-struct timeval utot = { 0,0 },stot = { 0,0 };
+struct rusage tot;
 time_t maxend,minbeg;
 
 	if (!jn->procs)
 		return;
+	memset(&tot,0,sizeof tot);
 	if (!jn->procs->next)
-		printtime(pn->endtime-pn->bgtime,&pn->ru_utime,&pn->ru_stime,pn->text);
+		printtime(pn->endtime-pn->bgtime,&pn->ru,pn->text);
 	else
 		{
 		maxend = jn->procs->endtime;
@@ -607,15 +896,14 @@ time_t maxend,minbeg;
 		printheader();
 		for (pn = jn->procs; pn; pn = pn->next)
 			{
-			printtimes(pn->endtime-pn->bgtime,&pn->ru_utime,&pn->ru_stime,pn->text);
-			addtimeval(&utot,&pn->ru_utime);
-			addtimeval(&stot,&pn->ru_stime);
+			printtimes(pn->endtime-pn->bgtime,&pn->ru,pn->text);
+			addrusage(&tot,&pn->ru);
 			if (pn->endtime > maxend)
 				maxend = pn->endtime;
 			if (pn->bgtime < minbeg)
 				minbeg = pn->bgtime;
 			}
-		printtimes(maxend-minbeg,&utot,&stot,"total");
+		printtimes(maxend-minbeg,&tot,"total");
 		}
 }
 
@@ -625,7 +913,7 @@ void killrunjobs(void)
 {
 int t0,killed = 0;
 
-	for (t0 = 1; t0 != MAXJOB; t0++)
+	for (t0 = 1; t0 != maxjob; t0++)
 		if (t0 != curjob && jobtab[t0].stat &&
 				!(jobtab[t0].stat & STAT_STOPPED))
 			{
@@ -642,10 +930,10 @@ void checkjobs(void)
 {
 int t0;
 
-	for (t0 = 1; t0 != MAXJOB; t0++)
+	for (t0 = 1; t0 != maxjob; t0++)
 		if (t0 != curjob && jobtab[t0].stat)
 			break;
-	if (t0 != MAXJOB)
+	if (t0 != maxjob)
 		{
 		if (jobtab[t0].stat & STAT_STOPPED)
 			{
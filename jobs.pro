@@ -1,18 +1,30 @@
 HANDTYPE handler(int sig,int code);
+void mksigfds(void);
+int handlesigs(void);
+void waitsig(void);
+void reap(void);
 void makerunning(struct jobnode *jn);
 void updatestatus(struct jobnode *jn);
-void findproc(int pid,struct jobnode **jptr,struct procnode **pptr);
+struct procnode *findproc(long pid);
+void hashproc(struct procnode *pn);
+void unhashproc(struct procnode *pn);
 void printjob(struct jobnode *jn,int lng);
 void setprevjob(void);
 void initjob(int flags);
 struct procnode *addproc(long pid,char *text);
 int execok(void);
-void chldsuspend(void);
 void waitjobs(void);
 void clearjobtab(void);
+void growjobtab(void);
+void freejob(int job);
+void deletejob(int job);
+void adddead(int job,long pid,int stat);
+struct deadjob *getdead(int job,long pid);
+int bgrunning(int job);
 int getfreejob(void);
 void spawnjob(void);
 void fixsigs(void);
+void printrusage(struct rusage *ru);
 void dumptime(struct jobnode *jn);
 void killrunjobs(void);
 void checkjobs(void);
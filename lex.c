@@ -612,8 +612,8 @@ char *s;
 			return 0;
 			}
 		an->inuse = 1;
-		hungets(strdup(ALPOPS));
-		hungets(strdup((alstack[alix++] = an)->text));
+		hungets(ALPOPS);
+		hungets((alstack[alix++] = an)->text);
 		alstat = 0;
 		if (tstr)
 			free(tstr);
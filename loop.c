@@ -36,7 +36,7 @@
 
 int parfor(comm comm,int isfor)
 {
-struct fornode *node = alloc(sizeof(struct fornode));
+struct fornode *node = palloc(sizeof(struct fornode));
 char *comnam = (isfor) ? "for" : "select";
 
 	comm->type = (isfor) ? CFOR : CSELECT;
@@ -47,7 +47,41 @@ char *comnam = (isfor) ? "for" : "select";
 		errflag = 1;
 		return 0;
 		}
-	node->name = tstr;
+	node->par = node->grpout = 0;
+	while (isfor && peek == STRING && *tstr == '-')
+		{
+		if (!strcmp(tstr,"-O"))
+			node->grpout = 1;
+		else if (!strcmp(tstr,"-P"))
+			{
+			free(tstr);
+			matchit();
+			if (peek != STRING || (node->par = atoi(tstr)) < 1)
+				{
+				zerr("parse error in for: number expected after -P");
+				errflag = 1;
+				return 1;
+				}
+			}
+		else
+			{
+			zerr("parse error in for: bad option: %s",tstr);
+			free(tstr);
+			errflag = 1;
+			return 1;
+			}
+		free(tstr);
+		matchit();
+		if (peek != STRING)
+			{
+			zerr("parse error in for: identifier expected");
+			errflag = 1;
+			return 0;
+			}
+		}
+	if (node->grpout && !node->par)
+		node->par = 1;
+	node->name = pmovestr(tstr);
 	matchit();
 	node->list = NULL;
 	node->inflag = 0;
@@ -58,14 +92,14 @@ char *comnam = (isfor) ? "for" : "select";
 		matchit();
 		while (peek == STRING)
 			{
-			addnode(comm->args,tstr);
+			paddnode(comm->args,pmovestr(tstr));
 			matchit();
 			}
 		}
 	if (peek != NEWLIN && peek != SEMI)
 		{
 		zerr("parse error: bad token in '%s' list",comnam);
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	incmd = 0;
@@ -75,19 +109,16 @@ char *comnam = (isfor) ? "for" : "select";
 	if (peek != DO)
 		{
 		zerr("parse error: 'do' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
 	if (!(node->list = parlist(1)))
-		{
-		freecmd(comm);
 		return 1;
-		}
 	if (peek != DONE)
 		{
 		zerr("parse error: 'done' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -96,7 +127,7 @@ char *comnam = (isfor) ? "for" : "select";
  
 int parcase(comm comm)
 {
-struct casenode *node = alloc(sizeof(struct casenode)),*last = NULL;
+struct casenode *node = palloc(sizeof(struct casenode)),*last = NULL;
 char *tok; /* add FREES to this function */
 
 	comm->type = CCASE;
@@ -107,7 +138,7 @@ char *tok; /* add FREES to this function */
 		errflag = 1;
 		return 0;
 		}
-	addnode(comm->args,tstr);
+	paddnode(comm->args,pmovestr(tstr));
 	matchit();
 	if (peek != STRING || strcmp(tstr,"in"))
 		{
@@ -117,8 +148,8 @@ char *tok; /* add FREES to this function */
 		}
 	while (tok = getcasepat())
 		{
-		node = alloc(sizeof(struct casenode));
-		node->pat = tok;
+		node = palloc(sizeof(struct casenode));
+		node->pat = pmovestr(tok);
 		if (last)
 			last->next = node;
 		else
@@ -127,6 +158,7 @@ char *tok; /* add FREES to this function */
 		if (peek != DSEMI)
 			{
 			zerr("parse error: ;; expected");
+			errflag = 1;
 			return 1;
 			}
 		}
@@ -206,6 +238,7 @@ char *buf = zalloc(bsiz),*ptr,*s;
 				{
 				free(buf);
 				zerr("parse error: 'esac' expected");
+				errflag = 1;
 				return NULL;
 				}
 			}
@@ -232,51 +265,42 @@ char *buf = zalloc(bsiz),*ptr,*s;
  
 int parif(comm comm)
 {
-struct ifnode *node = alloc(sizeof(struct ifnode));
+struct ifnode *node = palloc(sizeof(struct ifnode));
  
 	comm->type = CIF;
 	comm->info = node;
 do_then:
 	node->next = NULL;
 	if (!(node->ifl = parlist(1)))
-		{
-		freecmd(comm);
 		return 1;
-		}
 	if (peek != THEN)
 		{
 		zerr("parse error: 'then' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
 	if (!(node->thenl = parlist(1)))
-		{
-		freecmd(comm);
 		return 1;
-		}
 	if (peek == ELIF)
 		{
 		matchit();
-		node = node->next = alloc(sizeof(struct ifnode));
+		node = node->next = palloc(sizeof(struct ifnode));
 		goto do_then;
 		}
 	else if (peek == ELSE)
 		{
 		matchit();
-		node = node->next = alloc(sizeof(struct ifnode));
+		node = node->next = palloc(sizeof(struct ifnode));
 		node->next = NULL;
 		node->ifl = NULL;
 		if (!(node->thenl = parlist(1)))
-			{
-			freecmd(comm);
 			return 1;
-			}
 		}
 	if (peek != FI)
 		{
 		zerr("parse error: 'fi' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -287,21 +311,18 @@ do_then:
 
 int parwhile(comm comm,int cond)
 {
-struct whilenode *node = alloc(sizeof (struct whilenode));
+struct whilenode *node = palloc(sizeof (struct whilenode));
  
 	comm->type = CWHILE;
 	comm->info = node;
 	node->cond = cond;
 	node->loop = node->cont = NULL;
 	if (!(node->cont = parlist(1)))
-		{
-		freecmd(comm);
 		return NULL;
-		}
 	if (peek != DO)
 		{
 		zerr("parse error: 'do' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -309,7 +330,7 @@ struct whilenode *node = alloc(sizeof (struct whilenode));
 	if (peek != DONE)
 		{
 		zerr("parse error: 'done' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -318,7 +339,7 @@ struct whilenode *node = alloc(sizeof (struct whilenode));
  
 int parrepeat(comm comm)
 {
-struct repeatnode *node = alloc(sizeof (struct repeatnode));
+struct repeatnode *node = palloc(sizeof (struct repeatnode));
 
 	comm->type = CREPEAT;
 	comm->info = node;
@@ -326,7 +347,7 @@ struct repeatnode *node = alloc(sizeof (struct repeatnode));
 	if (peek != STRING || !isdigit(*tstr))
 		{
 		zerr("parse error: number expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	node->count = atoi(tstr);
@@ -338,7 +359,7 @@ struct repeatnode *node = alloc(sizeof (struct repeatnode));
 	if (peek != DO)
 		{
 		zerr("parse error: 'do' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -346,7 +367,7 @@ struct repeatnode *node = alloc(sizeof (struct repeatnode));
 	if (peek != DONE)
 		{
 		zerr("parse error: 'done' expected");
-		freecmd(comm);
+		errflag = 1;
 		return 1;
 		}
 	matchit();
@@ -355,7 +376,6 @@ struct repeatnode *node = alloc(sizeof (struct repeatnode));
 
 void execfor(comm comm)
 {
-list list;
 struct fornode *node;
 char *str;
 table args;
@@ -370,11 +390,16 @@ int cj = curjob;
 		args = duptable(pparms,dupstr);
 		freestr(getnode(args));
 		}
+	if (node->par)
+		{
+		execparfor(node,args);
+		curjob = cj;
+		return;
+		}
 	while (str = getnode(args))
 		{
 		setparm(strdup(node->name),str,0,0);
-		list = duplist(node->list);
-		execlist(list);
+		execlist(node->list);
 		if (breaks)
 			{
 			breaks--;
@@ -386,9 +411,143 @@ int cj = curjob;
 	curjob = cj;
 }
 
+/* run a for loop with each iteration in a background job, at most
+	node->par of them at a time.  The status is that of the last
+	iteration (in loop order) that failed, or 0. */
+
+void execparfor(struct fornode *node,table args)
+{
+struct forjob *fj = zalloc(node->par*sizeof *fj);
+int cj = curjob,running = 0,num = 0,failnum = -1,stat = 0,t0,fd;
+long pid;
+char *str,*text,*nam;
+
+	for (t0 = 0; t0 != node->par; t0++)
+		fj[t0].job = 0;
+	while (!errflag && (str = getnode(args)))
+		{
+		while (running == node->par && !errflag)
+			{
+			waitsig();
+			running -= reapfor(fj,node->par,&failnum,&stat);
+			}
+		if (errflag)
+			{
+			free(str);
+			break;
+			}
+		fd = -1;
+		if (node->grpout)
+			{
+			nam = gettemp();
+			fd = movefd(open(nam,O_RDWR|O_CREAT|O_EXCL,0600));
+			if (fd == -1)
+				zerr("can't create temp file: %e",errno);
+			else
+				unlink(nam);
+			free(nam);
+			}
+		text = (jobbing) ? tricat(node->name,"=",str) : NULL;
+		setparm(strdup(node->name),str,0,0);
+		curjob = getfreejob();
+		initjob(0);
+		if (!(pid = phork()))
+			{
+			entersubsh(1,0);
+			exiting = 1;
+			if (fd != -1)
+				redup(fd,1);
+			execlist(node->list);
+			fflush(stdout);
+			_exit(lastval);
+			}
+		if (pid == -1)
+			{
+			if (text)
+				free(text);
+			if (fd != -1)
+				close(fd);
+			freejob(curjob);
+			curjob = cj;
+			errflag = 1;
+			break;
+			}
+		addproc(pid,text);
+		for (t0 = 0; fj[t0].job; t0++);
+		fj[t0].job = curjob;
+		fj[t0].fd = fd;
+		fj[t0].num = num++;
+		running++;
+		curjob = cj;
+		}
+	if (errflag)
+		for (t0 = 0; t0 != node->par; t0++)
+			if (fj[t0].job && bgrunning(fj[t0].job))
+				killjb(jobtab+fj[t0].job,SIGINT);
+	while (running)
+		{
+		waitsig();
+		running -= reapfor(fj,node->par,&failnum,&stat);
+		}
+	free(fj);
+	lastval = stat;
+}
+
+/* clean up the iterations of a parallel for loop that have finished,
+	printing their output if it was kept.  Returns how many there
+	were. */
+
+int reapfor(struct forjob *fj,int ct,int *failnum,int *stat)
+{
+struct deadjob *dj;
+struct procnode *pn;
+int t0,s,done = 0,len;
+char buf[4096];
+
+	for (t0 = 0; t0 != ct; t0++,fj++)
+		{
+		if (!fj->job || bgrunning(fj->job))
+			continue;
+		if (jobtab[fj->job].stat & STAT_STOPPED)
+			{
+			/* leave it behind as an ordinary stopped job */
+
+			for (pn = jobtab[fj->job].procs; pn->next; pn = pn->next);
+			s = 0200|WSTOPSIG(SP(pn->statusp));
+			jobtab[fj->job].stat |= STAT_LOCKED;
+			}
+		else
+			{
+			/* the status is kept on the job; its dead record isn't
+				needed, as nothing else waits for it */
+
+			s = jobtab[fj->job].val;
+			for (pn = jobtab[fj->job].procs; pn->next; pn = pn->next);
+			if (dj = getdead(0,pn->pid))
+				free(dj);
+			deletejob(fj->job);
+			}
+		if (fj->fd != -1)
+			{
+			fflush(stdout);
+			lseek(fj->fd,0L,0);
+			while ((len = read(fj->fd,buf,sizeof buf)) > 0)
+				write(1,buf,len);
+			close(fj->fd);
+			}
+		if (s && fj->num > *failnum)
+			{
+			*failnum = fj->num;
+			*stat = s;
+			}
+		fj->job = 0;
+		done++;
+		}
+	return done;
+}
+
 void execselect(comm comm)
 {
-list list;
 struct fornode *node;
 char *str,*s;
 table args;
@@ -411,7 +570,7 @@ int cj = curjob,t0;
 				str = readline(putprompt("PROMPT3"));
 				}
 			else
-				str = fgets(zalloc(256),256,bshin);
+				str = ingets(bshin);
 			if (!str || errflag)
 				{
 				fprintf(stderr,"\n");
@@ -434,8 +593,7 @@ int cj = curjob,t0;
 				str = "";
 			}
 		setparm(strdup(node->name),strdup(str),0,0);
-		list = duplist(node->list);
-		execlist(list);
+		execlist(node->list);
 		if (breaks)
 			{
 			breaks--;
@@ -452,7 +610,6 @@ done:
  
 void execwhile(comm comm)
 {
-list list;
 struct whilenode *node;
 int cj = curjob; 
 
@@ -461,8 +618,7 @@ int cj = curjob;
 	exiting = 0;
 	FOREVER
 		{
-		list = duplist(node->cont);
-		execlist(list);
+		execlist(node->cont);
 		if (!((lastval == 0) ^ node->cond))
 			break;
 		if (breaks)
@@ -472,25 +628,23 @@ int cj = curjob;
 				break;
 			contflag = 0;
 			}
-		list = duplist(node->loop);
-		execlist(list);
+		execlist(node->loop);
 		}
 	curjob = cj;
 }
  
 void execrepeat(comm comm)
 {
-list list;
 struct repeatnode *node;
-int cj = curjob;
+int cj = curjob,count;
 
 	loops++;
 	node = comm->info;
+	count = node->count;
 	exiting = 0;
-	while (node->count--)
+	while (count--)
 		{
-		list = duplist(node->list);
-		execlist(list);
+		execlist(node->list);
 		if (breaks)
 			{
 			breaks--;
@@ -506,7 +660,6 @@ int cj = curjob;
  
 void execif(comm comm)
 {
-list list;
 struct ifnode *node;
 int cj = curjob;
 
@@ -516,16 +669,14 @@ int cj = curjob;
 		{
 		if (node->ifl)
 			{
-			list = duplist(node->ifl);
-			execlist(list);
+			execlist(node->ifl);
 			if (lastval)
 				{
 				node = node->next;
 				continue;
 				}
 			}
-		list = duplist(node->thenl);
-		execlist(list);
+		execlist(node->thenl);
 		break;
 		}
 	curjob = cj;
@@ -533,7 +684,6 @@ int cj = curjob;
  
 void execcase(comm comm)
 {
-list list;
 struct casenode *node;
 char *word;
 table args;
@@ -555,119 +705,66 @@ int cj = curjob;
 		else
 			node = node->next;
 	if (node)
-		{
-		list = duplist(node->list);
-		execlist(list);
-		}
+		execlist(node->list);
 	curjob = cj;
 }
  
-list duplist(list xlist)
-{
-list nlist;
- 
-	if (!xlist)
-		return NULL;
-	nlist = alloc(sizeof(struct lnode));
-	nlist->left = duplist2(xlist->left);
-	nlist->right = duplist(xlist->right);
-	nlist->type = xlist->type;
-	return nlist;
-}
-
-void freelist(list xlist)
-{
-	if (xlist)
-		{
-		freelist2(xlist->left);
-		freelist(xlist->right);
-		free(xlist);
-		}
-}
+/* drop a reference to a shell function body, freeing it
+	when the last holder lets go */
 
-list2 duplist2(list2 x)
+void unreflist(list l)
 {
-list2 y;
-
-	if (!x)
-		return NULL;
-	y = alloc(sizeof(struct l2node));
-	*y = *x;
-	y->left = duppline(x->left);
-	y->right = duplist2(x->right);
-	return y;
+	if (l->refs)
+		l->refs--;
+	else
+		freearena(l->arena);
 }
 
-void freelist2(list2 x)
-{
-	if (x)
-		{
-		freepline(x->left);
-		freelist2(x->right);
-		free(x);
-		}
-}
+/* copy the words of a command so that it can be expanded and
+	executed without touching the parse tree; the lists hanging
+	off left and info are shared, not copied */
 
-pline duppline(pline xpline)
+comm copycomm(comm xcomm)
 {
-pline npline;
- 
-	if (!xpline)
-		return NULL;
-	npline = alloc(sizeof(struct pnode));
-	npline->left = dupcomm(xpline->left);
-	npline->right = duppline(xpline->right);
-	npline->type = xpline->type;
-	return npline;
-}
+comm ncomm = alloc(sizeof(struct cnode));
 
-void freepline(pline x)
-{
-	if (x)
-		{
-		freecmd(x->left);
-		freepline(x->right);
-		free(x);
-		}
-}
-
-comm dupcomm(comm xcomm)
-{
-comm ncomm;
-void *(*duprs[])(void *) = {dupfor,dupwhile,duprepeat,dupif,dupcase};
-int type;
- 
-	if (!xcomm)
-		return NULL;
-	ncomm = alloc(sizeof(struct cnode));
-	ncomm->left = duplist(xcomm->left);
+	*ncomm = *xcomm;
 	ncomm->cmd = dupstr(xcomm->cmd);
 	ncomm->args = duptable(xcomm->args,dupstr);
 	ncomm->redir = duptable(xcomm->redir,dupfnode);
 	ncomm->vars = (xcomm->vars) ? duptable(xcomm->vars,dupstr) : NULL;
-	ncomm->type = type = xcomm->type;
-	if (type >= CFOR && type <= CCASE)
-		ncomm->info = (duprs[type-CFOR])(xcomm->info);
 	return ncomm;
 }
 
-void freecmd(comm x)
+/* free a copy made by copycomm; if it is a shell function call,
+	let go of the function body */
+
+void freecopy(comm x)
 {
-	if (x)
-		{
-		freelist(x->left);
-		if (x->cmd)
-			free(x->cmd);
-		if (x->args)
-			freetable(x->args,freestr);
-		if (x->redir)
-			freetable(x->redir,freeredir);
-		if (x->vars)
-			freetable(x->vars,freestr);
-/*		if (x->info)
-			freeinfo(x->info);*/
-		free(x);
-		}
+struct fnode *fn;
+char *s;
+
+	if (x->type == SHFUNC)
+		unreflist(x->left);
+	if (x->cmd)
+		free(x->cmd);
+	while (s = getnode(x->args))
+		free(s);
+	free(x->args);
+	while (fn = getnode(x->redir))
+		{
+		if (fn->type < HEREDOC || fn->type == INPIPE || fn->type == OUTPIPE)
+			free(fn->u.name);
+		free(fn);
+		}
+	free(x->redir);
+	if (x->vars)
+		{
+		while (s = getnode(x->vars))
+			free(s);
+		free(x->vars);
+		}
+	free(x);
 }
 
 void *dupstr(void *str)
@@ -684,73 +781,11 @@ struct fnode *fn = i,*nfn = alloc(sizeof(struct fnode));
 	if (!i)
 		return NULL;
 	*nfn = *fn;
-	if (nfn->type < HEREDOC)
+	if (nfn->type < HEREDOC || nfn->type == INPIPE || nfn->type == OUTPIPE)
 		nfn->u.name = strdup(fn->u.name);
 	return nfn;
 }
 
-void *dupfor(void *i)
-{
-struct fornode *nnode,*node = i;
- 
-	nnode = alloc(sizeof(struct fornode));
-	*nnode = *(struct fornode *) i;
-	nnode->name = strdup(node->name);
-	nnode->list = duplist(node->list);
-	return nnode;
-}
- 
-void *dupcase(void *i)
-{
-struct casenode *nnode,*node = i;
- 
-	if (!i)
-		return NULL;
-	nnode = alloc(sizeof(struct casenode));
-	nnode->next = dupcase(node->next);
-	nnode->list = duplist(node->list);
-	nnode->pat = strdup(node->pat);
-	return nnode;
-}
- 
-void *dupif(void *i)
-{
-struct ifnode *nnode,*node = i;
- 
-	if (!i)
-		return NULL;
-	nnode = alloc(sizeof(struct ifnode));
-	nnode->next = dupif(node->next);
-	nnode->ifl = duplist(node->ifl);
-	nnode->thenl = duplist(node->thenl);
-	return nnode;
-}
- 
-void *dupwhile(void *i)
-{
-struct whilenode *nnode,*node = i;
- 
-	if (!i)
-		return NULL;
-	nnode = alloc(sizeof(struct whilenode));
-	nnode->cond = node->cond;
-	nnode->cont = duplist(node->cont);
-	nnode->loop = duplist(node->loop);
-	return nnode;
-}
-
-void *duprepeat(void *i)
-{
-struct repeatnode *nnode,*node = i;
-
-	if (!i)
-		return NULL;
-	nnode = alloc(sizeof(struct repeatnode));
-	nnode->count = node->count;
-	nnode->list = duplist(node->list);
-	return nnode;
-}	
-
 table duptable(table tab,void *(*func)(void *))
 {
 table ret;
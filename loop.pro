@@ -5,24 +5,16 @@ int parif(comm comm);
 int parwhile(comm comm,int cond);
 int parrepeat(comm comm);
 void execfor(comm comm);
+void execparfor(struct fornode *node,table args);
+int reapfor(struct forjob *fj,int ct,int *failnum,int *stat);
 void execselect(comm comm);
 void execwhile(comm comm);
 void execrepeat(comm comm);
 void execif(comm comm);
 void execcase(comm comm);
-list duplist(list xlist);
-void freelist(list xlist);
-list2 duplist2(list2 x);
-void freelist2(list2 x);
-pline duppline(pline xpline);
-void freepline(pline x);
-comm dupcomm(comm xcomm);
-void freecmd(comm x);
+void unreflist(list l);
+comm copycomm(comm xcomm);
+void freecopy(comm x);
 void *dupstr(void *str);
 void *dupfnode(void *i);
-void *dupfor(void *i);
-void *dupcase(void *i);
-void *dupif(void *i);
-void *dupwhile(void *i);
-void *duprepeat(void *i);
 table duptable(table tab,void *(*func)(void *));
@@ -45,18 +45,18 @@ comm c;
 		return l1;
 	if (errflag)
 		return NULL;
-	c = alloc(sizeof *c);
-	c->cmd = strdup("");
-	c->args = newtable();
-	c->redir = newtable();
+	c = palloc(sizeof *c);
+	c->cmd = pstrdup("");
+	c->args = pnewtable();
+	c->redir = pnewtable();
 	c->type = SIMPLE;
-	p = alloc(sizeof *p);
+	p = palloc(sizeof *p);
 	p->left = c;
 	p->type = END;
-	l2 = alloc(sizeof *l2);
+	l2 = palloc(sizeof *l2);
 	l2->left = p;
 	l2->type = END;
-	l1 = alloc(sizeof *l1);
+	l1 = palloc(sizeof *l1);
 	l1->left = l2;
 	l1->type = SYNC;
 	return l1;
@@ -66,7 +66,7 @@ comm c;
 
 list parlist1(int nest)
 {
-list l1 = (list) alloc(sizeof *l1);
+list l1 = (list) palloc(sizeof *l1);
 int isnl;
 
 	incmd = 0;
@@ -75,11 +75,9 @@ int isnl;
 	if (nest)
 		while (peek == NEWLIN || peek == SEMI)
 			matchit();
+	l1->lineno = lineno;
 	if (!(l1->left = parlist2()))
-		{
-		free(l1);
 		return NULL;
-		}
 	l1->type = (peek == AMPER) ? ASYNC : SYNC;
 	if ((isnl = peek == NEWLIN) || peek == SEMI || peek == AMPER)
 		peek = EMPTY;
@@ -93,8 +91,6 @@ int isnl;
 					peek = EMPTY;
 				return l1;
 				}
-			freelist2(l1->left);
-			free(l1);
 			return NULL;
 			}
 		}
@@ -107,7 +103,7 @@ int isnl;
 
 list2 parlist2(void)
 {
-list2 l2 = (list2) alloc(sizeof *l2);
+list2 l2 = (list2) palloc(sizeof *l2);
 int iter = 0;
 
 	for (;;)
@@ -133,7 +129,6 @@ int iter = 0;
 		}
 	if (!(l2->left = parpline()))
 		{
-		free(l2);
 		if (!errflag && iter)
 			{
 			zerr("parse error: pipeline expected");
@@ -154,8 +149,6 @@ int iter = 0;
 				zerr("invalid null command");
 				errflag = 1;
 				}
-			freepline(l2->left);
-			free(l2);
 			return NULL;
 			}
 		}
@@ -171,30 +164,23 @@ int iter = 0;
 
 pline parpline(void)
 {
-pline p = (pline) alloc(sizeof *p);
+pline p = (pline) palloc(sizeof *p);
 
 	if (!(p->left = parcmd()))
-		{
-		free(p);
 		return NULL;
-		}
 	if (peek == HERR)
-		{
-		freecmd(p->left);
-		free(p);
 		return NULL;
-		}
 	if (peek == BAR || peek == BARAMP)
 		{
 		if (peek == BARAMP)
 			{
 			struct fnode *f;
 
-			f = alloc(sizeof *f);
+			f = palloc(sizeof *f);
 			f->type = MERGEOUT;
 			f->fd1 = 2;
 			f->u.fd2 = 1;
-			addnode(p->left->redir,f);
+			paddnode(p->left->redir,f);
 			}
 		matchit();
 		while (peek == NEWLIN)
@@ -207,8 +193,6 @@ pline p = (pline) alloc(sizeof *p);
 				zerr("invalid null command");
 				errflag = 1;
 				}
-			freecmd(p->left);
-			free(p);
 			return NULL;
 			}
 		}
@@ -224,7 +208,7 @@ pline p = (pline) alloc(sizeof *p);
 
 comm parcmd(void)
 {
-comm c = (comm) alloc(sizeof *c);
+comm c = (comm) palloc(sizeof *c);
 list l;
 char *str;
 int flag,iter = 0;
@@ -232,8 +216,8 @@ int flag,iter = 0;
 	incmd = 0;
 	c->left = NULL;
 	c->cmd = NULL;
-	c->args = newtable();
-	c->redir = newtable();
+	c->args = pnewtable();
+	c->redir = pnewtable();
 	c->type = SIMPLE;
 	c->vars = NULL;
 	if (peek == EOF)
@@ -245,11 +229,12 @@ foo:
 			return NULL;
 		case ENVSTRING:
 			if (!c->vars)
-				c->vars = newtable(); /* FIX */
+				c->vars = pnewtable(); /* FIX */
 			for (str = tstr; *str != '='; str++);
 			*str++ = '\0';
-			addnode(c->vars,tstr);
-			addnode(c->vars,strdup(str));
+			paddnode(c->vars,pstrdup(tstr));
+			paddnode(c->vars,pstrdup(str));
+			free(tstr);
 			matchit();
 			goto foo;
 		case FOR:
@@ -295,13 +280,9 @@ foo:
 			matchit();
 			c->type = SUBSH;
 			if (!(c->left = parlist(1)))
-				{
-				freecmd(c);
 				return NULL;
-				}
 			if (peek != OUTPAR)
 				{
-				freecmd(c);
 				zerr("parse error: '}' expected");
 				return NULL;
 				}
@@ -311,13 +292,9 @@ foo:
 			matchit();
 			c->type = CURSH;
 			if (!(c->left = parlist(1)))
-				{
-				freecmd(c);
 				return NULL;
-				}
 			if (peek != OUTBRACE)
 				{
-				freecmd(c);
 				zerr("parse error: '}' expected");
 				return NULL;
 				}
@@ -328,7 +305,7 @@ foo:
 			str = tstr;
 			if (peek != STRING && peek != ENVSTRING)
 				{
-				c->cmd = strdup("function");
+				c->cmd = pstrdup("function");
 				incmd = 1;
 				if (isredir())
 					goto jump1;
@@ -340,28 +317,15 @@ foo:
 			while (peek == NEWLIN);
 			if (peek != INBRACE)
 				{
-				freecmd(c);
 				zerr("parse error: '{' expected");
 				return NULL;
 				}
 			matchit();
 			flag = peek == OUTBRACE;
-			if (!(l = parlist(1)))
-				{
-				freecmd(c);
-				return NULL;
-				}
-			if (peek != OUTBRACE)
-				{
-				freelist(l);
-				freecmd(c);
-				zerr("parse error: '}' expected");
+			if (!(l = parfunc()))
 				return NULL;
-				}
-			matchit();
-			settrap(str,flag);
-			addhnode(str,l,shfunchtab,freeshfunc);
-			c->cmd = strdup("");
+			deffunc(str,l,flag);
+			c->cmd = pstrdup("");
 			c->type = SIMPLE;
 			break;
 		case EXEC:
@@ -379,27 +343,21 @@ jump1:
 			if (isredir())
 				{
 				if (parredir(c))
-					{
-					freecmd(c);
 					return NULL;
-					}
 				goto foo;
 				}
 			if (!(peek == STRING || peek == ENVSTRING))
 				{
 				if (full(c->redir))
 					{
-					c->cmd = strdup("cat");
+					c->cmd = pstrdup("cat");
 					return c;
 					}
 				if (c->vars)
 					{
-					c->cmd = strdup("");
+					c->cmd = pstrdup("");
 					return c;
 					}
-				free(c->args);
-				free(c->redir);
-				free(c);
 				if (iter && !errflag)
 					{
 					errflag = 1;
@@ -412,10 +370,7 @@ jump2:
 				if (isredir())
 					{
 					if (parredir(c))
-						{
-						freecmd(c);
 						return NULL;
-						}
 					}
 				else
 					{
@@ -427,35 +382,21 @@ jump2:
 						if (full(c->args))
 							{
 							zerr("illegal function definition");
-							freecmd(c);
 							return NULL;
 							}
 						while (peek == NEWLIN)
 							matchit();
 						if (peek != INBRACE)
 							{
-							freecmd(c);
 							zerr("parse error: '{' expected");
 							return NULL;
 							}
 						matchit();
 						flag = peek == OUTBRACE;
-						if (!(l = parlist(1)))
-							{
-							freecmd(c);
-							return NULL;
-							}
-						if (peek != OUTBRACE)
-							{
-							freelist(l);
-							freecmd(c);
-							zerr("parse error: '}' expected");
+						if (!(l = parfunc()))
 							return NULL;
-							}
-						matchit();
-						settrap(c->cmd,flag);
-						addhnode(c->cmd,l,shfunchtab,freeshfunc);
-						c->cmd = strdup("");
+						deffunc(strdup(c->cmd),l,flag);
+						c->cmd = pstrdup("");
 						c->type = SIMPLE;
 						incmd = 0;
 						return c;
@@ -463,17 +404,18 @@ jump2:
 					if (peek == ENVSTRING && (!incmd || opts[KEYWORD] == OPT_SET))
 						{
 						if (!c->vars)
-							c->vars = newtable(); /* FIX */
+							c->vars = pnewtable(); /* FIX */
 						for (str = tstr; *str != '='; str++);
 						*str++ = '\0';
-						addnode(c->vars,tstr);
-						addnode(c->vars,strdup(str));
+						paddnode(c->vars,pstrdup(tstr));
+						paddnode(c->vars,pstrdup(str));
+						free(tstr);
 						}
 					else if (c->cmd)
-						addnode(c->args,tstr);
+						paddnode(c->args,pmovestr(tstr));
 					else
 						{
-						c->cmd = tstr;
+						c->cmd = pmovestr(tstr);
 						incmd = 1;
 						}
 					matchit();
@@ -482,16 +424,10 @@ jump2:
 		}
 	while (isredir())
 		if (parredir(c))
-			{
-			freecmd(c);
 			return NULL;
-			}
 	incmd = 0;
 	if (peek == HERR)
-		{
-		freecmd(c);
 		return NULL;
-		}
 	return c;
 }
 
@@ -517,7 +453,7 @@ int getfdstr(char *s)
 
 int parredir(comm c)
 {
-struct fnode *fn = (struct fnode *) alloc(sizeof *fn);
+struct fnode *fn = (struct fnode *) palloc(sizeof *fn);
 int pk = peek,ic = incmd,mrg2 = 0;
 
 	fn->type = peek-OUTANG+WRITE;
@@ -549,14 +485,17 @@ int pk = peek,ic = incmd,mrg2 = 0;
 			zerr("parse error: bad process redirection");
 			return 1;
 			}
-		fn->u.name = tstr;
+		fn->u.name = pmovestr(tstr);
 		}
 	else if (fn->type == HEREDOC)
-		fn->u.fd2 = gethere(tstr);
+		{
+		if ((fn->u.fd2 = gethere(tstr)) != -1)
+			araddfd(parena,fn->u.fd2);
+		}
 	else if (pk >= OUTANGAMP && getfdstr(tstr) == -1)
 		{
 		mrg2 = 1;
-		fn->u.name = tstr;
+		fn->u.name = pmovestr(tstr);
 		fn->type = pk-OUTANGAMP;
 		}
 	else if (pk > OUTANGAMPBANG)
@@ -566,11 +505,11 @@ int pk = peek,ic = incmd,mrg2 = 0;
 		}
 	else if (pk == OUTANGAMPBANG)
 		{
-		struct fnode *fe = alloc(sizeof *fe);
+		struct fnode *fe = palloc(sizeof *fe);
 
 		fe->fd1 = fn->fd1;
 		fe->type = CLOSE;
-		addnode(c->redir,fe);
+		paddnode(c->redir,fe);
 		fn->u.fd2 = getfdstr(tstr);
 		if (fn->u.fd2 == -2)
 			fn->u.fd2 = spout;
@@ -588,18 +527,121 @@ int pk = peek,ic = incmd,mrg2 = 0;
 			}
 		}
 	else
-		fn->u.name = tstr;
-	addnode(c->redir,fn);
+		fn->u.name = pmovestr(tstr);
+	paddnode(c->redir,fn);
 	if (mrg2)
 		{
-		struct fnode *fe = alloc(sizeof *fe);
+		struct fnode *fe = palloc(sizeof *fe);
 
 		fe->fd1 = 2;
 		fe->u.fd2 = fn->fd1;
 		fe->type = MERGEOUT;
-		addnode(c->redir,fe);
+		paddnode(c->redir,fe);
 		}
 	matchit();
 	return 0;
 }
 
+
+/* parse a list into an arena of its own, returned in *ap;
+	the arena is freed again if nothing could be parsed */
+
+list parlista(int nest,struct arena **ap)
+{
+struct arena *a = parena;
+list l;
+
+	parena = *ap = newarena();
+	if (!(l = parlist(nest)))
+		freearena(*ap);
+	parena = a;
+	return l;
+}
+
+/* parse the body of a function definition into an arena of its own,
+	since it outlives the command it was defined in */
+
+list parfunc(void)
+{
+struct arena *a = parena;
+list l;
+
+	parena = newarena();
+	if (!(l = parlist(1)) || peek != OUTBRACE)
+		{
+		if (l)
+			zerr("parse error: '}' expected");
+		freearena(parena);
+		parena = a;
+		return NULL;
+		}
+	l->arena = parena;
+	compile(l,parena);
+	parena = a;
+	matchit();
+	return l;
+}
+
+/* define a function found by the parser; when compiling a file,
+	write it out instead */
+
+void deffunc(char *nam,list l,int empty)
+{
+	if (zwcout)
+		{
+		putzwc(ZWC_FUNC,empty,nam,l->prog);
+		freearena(l->arena);
+		free(nam);
+		return;
+		}
+	settrap(nam,empty);
+	addhnode(nam,l,shfunchtab,freeshfunc);
+}
+
+/* allocate a node of the parse tree */
+
+void *palloc(int l)
+{
+	parsenodes++;
+	parsebytes += l;
+	return aralloc(parena,l);
+}
+
+/* get an empty linked list header in the parse tree */
+
+table pnewtable(void)
+{
+	parsenodes++;
+	parsebytes += sizeof(struct xlist);
+	return arnewtable(parena);
+}
+
+/* add a node to the end of a linked list in the parse tree */
+
+void paddnode(table list,void *dat)
+{
+	parsenodes++;
+	parsebytes += sizeof(struct xnode);
+	araddnode(parena,list,dat);
+}
+
+/* copy a string into the parse tree */
+
+char *pstrdup(char *s)
+{
+int l = strlen(s)+1;
+char *t = aralloc(parena,l);
+
+	parsebytes += l;
+	return memcpy(t,s,l);
+}
+
+/* move a string from the lexer into the parse tree */
+
+char *pmovestr(char *s)
+{
+char *t = pstrdup(s);
+
+	free(s);
+	return t;
+}
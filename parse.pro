@@ -6,3 +6,11 @@ comm parcmd(void);
 int isredir(void);
 int getfdstr(char *s);
 int parredir(comm c);
+list parlista(int nest,struct arena **ap);
+list parfunc(void);
+void deffunc(char *nam,list l,int empty);
+void *palloc(int l);
+table pnewtable(void);
+void paddnode(table list,void *dat);
+char *pstrdup(char *s);
+char *pmovestr(char *s);
@@ -0,0 +1,286 @@
+/*
+
+	prof.c - profiling and tracing shell functions and commands
+
+	This file is part of zsh, the Z shell.
+
+   zsh is free software; no one can prevent you from reading the source
+   code, or giving it to someone else.
+   This file is copyrighted under the GNU General Public License, which
+   can be found in the file called COPYING.
+
+   Copyright (C) 1990 Paul Falstad
+
+   zsh is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY.  No author or distributor accepts
+   responsibility to anyone for the consequences of using it or for
+   whether it serves any particular purpose or works at all, unless he
+   says so in writing.  Refer to the GNU General Public License
+   for full details.
+
+   Everyone is granted permission to copy, modify and redistribute
+   zsh, but only under the conditions described in the GNU General Public
+   License.   A copy of this license is supposed to have been given to you
+   along with zsh so you can know your rights and responsibilities.
+   It should be in a file named COPYING.
+
+   Among other things, the copyright notice and this notice must be
+   preserved on all copies.
+
+*/
+
+#include "zsh.h"
+#include "funcs.h"
+#include <time.h>
+
+/* what has been profiled so far, by function name and by file:line */
+
+static htable proffuncs = NULL,proflines = NULL;
+
+/* the function and the line running now.  Each only counts the time
+	of those of its own kind that it runs as not its own. */
+
+static struct profframe *proftop[2];
+
+/* trace records are numbered within each process.  traceparent is
+	the id of the record of the innermost shell function call running
+	now, "" if none, and tracedepth is how many there are. */
+
+static long traceseq = 0;
+static char traceparent[TRACEIDLEN] = "";
+static int tracedepth = 0;
+
+/* the field zprof sorts by */
+
+static int profkey;
+
+/* get the wall clock time and the CPU time used by the shell and
+	its children so far, in seconds */
+
+static void proftimes(double *wall,double *cpu)
+{
+struct timeval tv;
+struct rusage self,kids;
+
+	gettimeofday(&tv,NULL);
+	getrusage(RUSAGE_SELF,&self);
+	getrusage(RUSAGE_CHILDREN,&kids);
+	*wall = tv.tv_sec+tv.tv_usec/1e6;
+	*cpu = self.ru_utime.tv_sec+self.ru_utime.tv_usec/1e6+
+		self.ru_stime.tv_sec+self.ru_stime.tv_usec/1e6+
+		kids.ru_utime.tv_sec+kids.ru_utime.tv_usec/1e6+
+		kids.ru_stime.tv_sec+kids.ru_stime.tv_usec/1e6;
+}
+
+/* start timing a function or line */
+
+void profenter(struct profframe *pf,int isline)
+{
+	proftimes(&pf->wall,&pf->cpu);
+	pf->cwall = pf->ccpu = 0;
+	pf->prev = proftop[isline];
+	proftop[isline] = pf;
+}
+
+/* stop timing a function or line, and add it to the totals for
+	nam.  Time spent in the functions (or for a line, the lines) it
+	ran counts toward its total, but not toward its self time. */
+
+void profleave(struct profframe *pf,char *nam,int isline)
+{
+struct profnode *pn;
+htable *ht = (isline) ? &proflines : &proffuncs;
+double wall,cpu;
+
+	proftimes(&wall,&cpu);
+	wall -= pf->wall;
+	cpu -= pf->cpu;
+	if (proftop[isline] = pf->prev)
+		{
+		pf->prev->cwall += wall;
+		pf->prev->ccpu += cpu;
+		}
+	if (!*ht)
+		*ht = newhtable(64);
+	if (!(pn = gethnode(nam,*ht)))
+		{
+		pn = alloc(sizeof *pn);
+		addhnode(strdup(nam),pn,*ht,NULL);
+		}
+	pn->calls++;
+	pn->total += wall;
+	pn->self += wall-pf->cwall;
+	pn->cpu += cpu;
+	pn->selfcpu += cpu-pf->ccpu;
+}
+
+/* stop timing a list, started on line ln when it was parsed.  A list
+	in a function is counted by the function's name and that line,
+	others by the script's name. */
+
+void proflist(struct profframe *pf,int ln)
+{
+char buf[MAXPATHLEN+12];
+
+	sprintf(buf,"%.*s:%d",MAXPATHLEN,(curfunc) ? curfunc :
+		(scriptname) ? scriptname : "-",ln);
+	profleave(pf,buf,1);
+}
+
+/* compare two profile entries by profkey, biggest first */
+
+static int profcmp(const void *a,const void *b)
+{
+struct hnode *x = *(struct hnode **) a,*y = *(struct hnode **) b;
+struct profnode *p = x->dat,*q = y->dat;
+double d;
+
+	switch (profkey)
+		{
+		case PROF_NAME:
+			return strcmp(x->nam,y->nam);
+		case PROF_CALLS:
+			return (p->calls < q->calls) - (p->calls > q->calls);
+		case PROF_TOTAL: d = q->total-p->total; break;
+		case PROF_CPU: d = q->cpu-p->cpu; break;
+		case PROF_SELFCPU: d = q->selfcpu-p->selfcpu; break;
+		default: d = q->self-p->self; break;
+		}
+	return (d > 0) - (d < 0);
+}
+
+/* print one table of the profile, sorted by key; if dump is set,
+	print it tab-separated with each line tagged with type */
+
+static void profprint(htable ht,int key,int dump,char *type)
+{
+struct hnode **arr,*hn;
+struct profnode *pn;
+int t0 = 0,ct = 0;
+
+	if (!ht || !ht->ct)
+		return;
+	arr = zalloc(ht->ct*sizeof *arr);
+	while (hn = nexthnode(ht,&t0))
+		arr[ct++] = hn;
+	profkey = key;
+	qsort(arr,ct,sizeof *arr,profcmp);
+	if (!dump)
+		printf("%8s %11s %11s %11s %11s  %s\n","calls","total","self",
+			"cpu","self cpu",type);
+	for (t0 = 0; t0 != ct; t0++)
+		{
+		pn = arr[t0]->dat;
+		if (dump)
+			printf("%s\t%s\t%ld\t%.6f\t%.6f\t%.6f\t%.6f\n",type,arr[t0]->nam,
+				pn->calls,pn->total,pn->self,pn->cpu,pn->selfcpu);
+		else
+			printf("%8ld %11.6f %11.6f %11.6f %11.6f  %s\n",pn->calls,pn->total,
+				pn->self,pn->cpu,pn->selfcpu,arr[t0]->nam);
+		}
+	free(arr);
+}
+
+/* print the profile: functions, then lines */
+
+void profreport(int key,int dump)
+{
+	profprint(proffuncs,key,dump,"function");
+	if (!dump && proffuncs && proffuncs->ct && proflines && proflines->ct)
+		putchar('\n');
+	profprint(proflines,key,dump,"line");
+}
+
+/* forget everything profiled so far */
+
+void profclear(void)
+{
+	if (proffuncs)
+		freehtab(proffuncs,freestr);
+	if (proflines)
+		freehtab(proflines,freestr);
+	proffuncs = proflines = NULL;
+}
+
+/* get the time from a clock that doesn't jump, in seconds */
+
+double tracenow(void)
+{
+struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/* add a JSON string to buf */
+
+static char *tracestr(char *buf,char *end,char *s)
+{
+	*buf++ = '"';
+	for (; s && *s && buf < end-8; s++)
+		if (*s == '"' || *s == '\\')
+			{
+			*buf++ = '\\';
+			*buf++ = *s;
+			}
+		else if ((unsigned char) *s < ' ')
+			buf += sprintf(buf,"\\u%04x",(unsigned char) *s);
+		else
+			*buf++ = *s;
+	*buf++ = '"';
+	return buf;
+}
+
+/* get the parts of the trace record of cmd that are known before it
+	runs: its id, which is put in id, the id of the function call it
+	was run from and how deep that is, the function, file and line it
+	was run from, and its name */
+
+char *tracebeg(char *cmd,char *id)
+{
+char buf[MAXPATHLEN+1024],*end = buf+sizeof buf,*s = buf;
+
+	sprintf(id,"%ld.%ld",(long) getpid(),++traceseq);
+	s += sprintf(s,"\"id\":\"%s\",\"parent\":\"%s\",\"depth\":%d,\"func\":",
+		id,traceparent,tracedepth);
+	s = tracestr(s,end-MAXPATHLEN-600,curfunc);
+	s += sprintf(s,",\"file\":");
+	s = tracestr(s,end-600,scriptname);
+	s += sprintf(s,",\"line\":%d,\"cmd\":",lineno);
+	s = tracestr(s,end,cmd);
+	*s = '\0';
+	return strdup(buf);
+}
+
+/* make the shell function call whose record has the given id the
+	parent of the records that follow, until tracereturn() puts back
+	the one saved in old */
+
+void tracecall(char *id,char *old)
+{
+	strcpy(old,traceparent);
+	strcpy(traceparent,id);
+	tracedepth++;
+}
+
+void tracereturn(char *old)
+{
+	strcpy(traceparent,old);
+	tracedepth--;
+}
+
+/* write a command's trace record, started by tracebeg() at time
+	start, as a line of JSON.  Each record is written in one piece,
+	so processes sharing the trace file don't garble each other's. */
+
+void traceend(char *fields,double start,long pid,int stat)
+{
+char buf[MAXPATHLEN+1200];
+int len;
+
+	len = sprintf(buf,"{\"ts\":%.6f,\"dur\":%.6f,\"pid\":%ld,\"status\":%d,%s}\n",
+		start,tracenow()-start,pid,stat,fields);
+	if (tracefd != -1)
+		write(tracefd,buf,len);
+	free(fields);
+}
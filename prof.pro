@@ -0,0 +1,10 @@
+void profenter(struct profframe *pf,int isline);
+void profleave(struct profframe *pf,char *nam,int isline);
+void proflist(struct profframe *pf,int ln);
+void profreport(int key,int dump);
+void profclear(void);
+double tracenow(void);
+char *tracebeg(char *cmd,char *id);
+void tracecall(char *id,char *old);
+void tracereturn(char *old);
+void traceend(char *fields,double start,long pid,int stat);
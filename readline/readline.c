@@ -5170,15 +5170,42 @@ register char *s1, *s2;
 
 #include <sys/errno.h>
 
+/* zsh's signal handler writes to sigfds[1]; while we wait for a key,
+   we let handlesigs () deal with whatever it has queued. */
+
+extern int sigfds[2];
+extern int handlesigs ();
+
 int
 rl_getc (stream)
 FILE *stream;
 {
-	int result;
+	int result, fd = fileno (stream);
 	unsigned char c;
+	fd_set fds;
 	
 	rl_waiting = 1;
-	result = read (fileno (stream), &c, sizeof (char));
+	for (;;)
+	  {
+	    FD_ZERO (&fds);
+	    FD_SET (fd, &fds);
+	    FD_SET (sigfds[0], &fds);
+	    result = select ((fd > sigfds[0] ? fd : sigfds[0]) + 1, &fds,
+			     (fd_set *)NULL, (fd_set *)NULL, (struct timeval *)NULL);
+	    if (result == -1 && (errno != EINTR || errflag))
+	      break;
+	    if (handlesigs ())
+	      {
+		errno = EINTR;
+		result = -1;
+		break;
+	      }
+	    if (result > 0 && FD_ISSET (fd, &fds))
+	      {
+		result = read (fd, &c, sizeof (char));
+		break;
+	      }
+	  }
 	rl_waiting = 0;
 	if (result == sizeof (char))
 		return (c);
@@ -5441,8 +5468,8 @@ rl_magic_space ()
 	str = strdup(the_line);
 	strinbeg();
 	magic = 1;
-	hungets(strdup("\n"));
-	hungets(strdup(the_line));
+	hungets("\n");
+	hungets(the_line);
 	while ((c = hgetc()) != EOF)
 	{
 		if (c == HERR)
@@ -317,7 +317,7 @@ char *str = *namptr,*cnam;
 					errflag = 1;
 					return 0;
 					}
-		 	else if (chn = gethnode(str+1,chtab))
+		 	else if (chn = hashcmd(str+1))
 				if (chn->type != BUILTIN)
 					cnam = strdup(chn->u.nam);
 				else
@@ -819,16 +819,23 @@ void execshfunc(comm comm)
 {
 table tab,oldlocals;
 Node n;
-char *s;
+char *s,*nam = comm->args->first->dat,*ocurfunc = curfunc;
+int prof = isset(PROFILE);
+struct profframe pf;
 
+	curfunc = nam;
 	tab = pparms;
 	oldlocals = locallist;
 	locallist = newtable();
 	for (n = tab->first; n; n = n->next);
 	pparms = comm->args;
-	runlist(comm->left);
+	if (prof)
+		profenter(&pf,0);
+	execcursh(comm);
+	if (prof)
+		profleave(&pf,nam,0);
 	retflag = 0;
-	comm->left = NULL;
+	curfunc = ocurfunc;
 	pparms = tab;
 	while (s = getnode(locallist))
 		{
@@ -44,138 +44,226 @@ table list;
 	return list;
 }
 
+/* the nam of a deleted hash table entry */
+
+static char hdeleted;
+
+/* entries of the old array moved along by each addhnode() while a
+	hash table is being resized */
+
+#define HMOVE 8
+
 /* get an empty hash table */
 
 htable newhtable(int size)
 {
 htable ret;
+int hsize = 8;
  
+	while (hsize < size)
+		hsize <<= 1;
 	ret = alloc(sizeof(struct xhtab));
-	ret->hsize = size;
-	ret->nodes = alloc(size*sizeof(struct hnode *));
+	ret->hsize = hsize;
+	ret->nodes = alloc(hsize*sizeof(struct hnode));
 	return ret;
 }
  
-/* Peter Weinberger's hash function */
+/* the FNV-1a hash function */
 
-int hasher(char *s)
+unsigned hasher(char *s)
 {
-unsigned hash = 0,g;
+unsigned hash = 2166136261U;
  
 	for (; *s; s++)
+		hash = (hash ^ (unsigned char) *s)*16777619U;
+	return hash;
+}
+
+/* find an entry in one array of a hash table */
+
+static struct hnode *hfind(struct hnode *arr,int size,char *nam,unsigned hval)
+{
+int t0 = hval & (size-1);
+struct hnode *hn;
+
+	for (; (hn = arr+t0)->nam; t0 = (t0+1) & (size-1))
+		if (hn->hval == hval && hn->nam != &hdeleted && !strcmp(hn->nam,nam))
+			return hn;
+	return NULL;
+}
+
+/* find where to put a new entry in one array of a hash table */
+
+static struct hnode *hslot(struct hnode *arr,int size,unsigned hval)
+{
+int t0 = hval & (size-1);
+
+	while (arr[t0].nam && arr[t0].nam != &hdeleted)
+		t0 = (t0+1) & (size-1);
+	return arr+t0;
+}
+
+/* start resizing a hash table that is getting full.  The entries are
+	moved to the new array a few at a time by later calls to addhnode.
+	If an earlier resize hasn't finished, what is left of its old array
+	goes straight into the new one, which is sized for ct; that counts
+	the entries of both arrays, so at least a quarter of it stays
+	empty. */
+
+static void hgrow(htable ht)
+{
+struct hnode *hn,*nodes;
+int nsize = 8,used = 0;
+
+	while (nsize < ht->ct*3)
+		nsize <<= 1;
+	nodes = alloc(nsize*sizeof(struct hnode));
+	if (ht->old)
+		{
+		for (; ht->opos != ht->osize; ht->opos++)
+			if ((hn = ht->old+ht->opos)->nam && hn->nam != &hdeleted)
+				{
+				*hslot(nodes,nsize,hn->hval) = *hn;
+				used++;
+				}
+		free(ht->old);
+		}
+	ht->old = ht->nodes;
+	ht->osize = ht->hsize;
+	ht->opos = 0;
+	ht->hsize = nsize;
+	ht->nodes = nodes;
+	ht->used = used;
+}
+
+/* move up to ct entries from the old array of a hash table being
+	resized to the new one.  Moved entries are marked deleted, so as
+	not to break the probe sequences of the ones left behind.  If the
+	new array gets too full to take another, it is resized in turn. */
+
+static void hmove(htable ht,int ct)
+{
+struct hnode *hn;
+
+	for (; ct && ht->old; ct--)
 		{
-		hash = (hash << 4) + *s;
-		if (g = hash & 0xf0000000)
+		hn = ht->old+ht->opos;
+		if (hn->nam && hn->nam != &hdeleted)
 			{
-			hash ^= g;
-			hash ^= g >> 24;
+			if ((ht->used+1)*4 > ht->hsize*3)
+				{
+				hgrow(ht);
+				continue;
+				}
+			*hslot(ht->nodes,ht->hsize,hn->hval) = *hn;
+			ht->used++;
+			hn->nam = &hdeleted;
+			}
+		if (++ht->opos == ht->osize)
+			{
+			free(ht->old);
+			ht->old = NULL;
 			}
 		}
-	return hash;
 }
 
 /* add a node to a hash table */
 
 void addhnode(char *nam,void *dat,htable ht,void (*freefunc)(void *))
 {
-int hval = hasher(nam) % ht->hsize;
-struct hnode *hp = ht->nodes[hval],*hn;
+unsigned hval = hasher(nam);
+struct hnode *hn;
  
-	for (; hp; hp = hp->hchain)
-		if (!strcmp(hp->nam,nam))
-			{
-			freefunc(hp->dat);
-			hp->dat = dat;
-			free(nam);
-			return;
-			}
-	hn = (void *) alloc(sizeof(struct hnode));
+	if ((hn = hfind(ht->nodes,ht->hsize,nam,hval)) ||
+			(ht->old && (hn = hfind(ht->old,ht->osize,nam,hval))))
+		{
+		freefunc(hn->dat);
+		hn->dat = dat;
+		free(nam);
+		return;
+		}
+	if (ht->old)
+		hmove(ht,HMOVE);
+	if ((ht->used+1)*4 > ht->hsize*3)
+		hgrow(ht);
+	hn = hslot(ht->nodes,ht->hsize,hval);
+	if (!hn->nam)
+		ht->used++;
 	hn->nam = nam;
 	hn->dat = dat;
-	hn->hchain = ht->nodes[hval];
-	ht->nodes[hval] = hn;
-	if (++ht->ct == ht->hsize*4)
-		expandhtab(ht);
+	hn->hval = hval;
+	ht->ct++;
 }
 
-/* expand hash tables when they get too many entries */
+/* find an entry in a hash table */
 
-void expandhtab(htable ht)
+static struct hnode *hlookup(char *nam,htable ht)
 {
-struct hnode *hp,**arr,**ha,*hn;
-int osize = ht->hsize,nsize = osize*8;
+unsigned hval = hasher(nam);
+struct hnode *hn;
 
-	ht->hsize = nsize;
-	arr = ht->nodes;
-	ht->nodes = alloc(nsize*sizeof(struct hnode *));
-	for (ha = arr; osize; osize--,ha++)
-		for (hn = *ha; hn; )
-			{
-			addhnode(hn->nam,hn->dat,ht,NULL);
-			hp = hn->hchain;
-			free(hn);
-			hn = hp;
-			}
-	free(arr);
+	if (!(hn = hfind(ht->nodes,ht->hsize,nam,hval)) && ht->old)
+		hn = hfind(ht->old,ht->osize,nam,hval);
+	return hn;
 }
 
 /* get an entry in a hash table */
 
 void *gethnode(char *nam,htable ht)
 {
-int hval = hasher(nam) % ht->hsize;
-struct hnode *hn = ht->nodes[hval];
+struct hnode *hn = hlookup(nam,ht);
  
-	for (; hn; hn = hn->hchain)
-		if (!strcmp(hn->nam,nam))
-			return hn->dat;
+	return (hn) ? hn->dat : NULL;
+}
+
+/* get the entry after position *pos of a hash table, to go through
+	all of them; start with *pos == 0 */
+
+struct hnode *nexthnode(htable ht,int *pos)
+{
+struct hnode *hn;
+int osize = (ht->old) ? ht->osize : 0;
+
+	while (*pos < osize+ht->hsize)
+		{
+		hn = (*pos < osize) ? ht->old+*pos : ht->nodes+*pos-osize;
+		++*pos;
+		if (hn->nam && hn->nam != &hdeleted)
+			return hn;
+		}
 	return NULL;
 }
  
+/* free a hash table and everything in it */
+
 void freehtab(htable ht,void (*freefunc)(void *))
 {
-int val;
-struct hnode *hn,**hptr = &ht->nodes[0],*next;
+struct hnode *hn;
+int pos = 0;
  
-	for (val = ht->hsize; val; val--,hptr++)
-		for (hn = *hptr; hn; )
-			{
-			next = hn->hchain;
-			freefunc(hn);
-			hn = next;
-			}
+	while (hn = nexthnode(ht,&pos))
+		{
+		free(hn->nam);
+		freefunc(hn->dat);
+		}
+	if (ht->old)
+		free(ht->old);
+	free(ht->nodes);
+	free(ht);
 }
 
 /* remove a hash table entry and return a pointer to it */
 
 void *remhnode(char *nam,htable ht)
 {
-int hval = hasher(nam) % ht->hsize;
-struct hnode *hn = ht->nodes[hval],*hp;
-void *dat;
+struct hnode *hn = hlookup(nam,ht);
 
 	if (!hn)
 		return NULL;
-	if (!strcmp(hn->nam,nam))
-		{
-		ht->nodes[hval] = hn->hchain;
-		dat = hn->dat;
-		free(hn->nam);
-		free(hn);
-		ht->ct--;
-		return dat;
-		}
-	for (hp = hn, hn = hn->hchain; hn; hn = (hp = hn)->hchain)
-		if (!strcmp(hn->nam,nam))
-			{
-			hp->hchain = hn->hchain;
-			dat = hn->dat;
-			free(hn->nam);
-			free(hn);
-			ht->ct--;
-			return dat;
-			}
-	return NULL;
+	free(hn->nam);
+	hn->nam = &hdeleted;
+	ht->ct--;
+	return hn->dat;
 }
  
 void *zalloc(int l)
@@ -204,6 +292,95 @@ void *z;
 	return z;
 }
 
+/* get an empty arena */
+
+struct arena *newarena(void)
+{
+	return alloc(sizeof(struct arena));
+}
+
+/* allocate zeroed memory from an arena */
+
+void *aralloc(struct arena *a,int l)
+{
+struct arblk *b;
+char *z;
+
+	l = (l+sizeof(long)-1) & ~(sizeof(long)-1);
+	if (a->end-a->ptr < l)
+		{
+		int bsiz = (l > ARBLKSIZ/4) ? l : ARBLKSIZ;
+
+		b = zalloc(sizeof(struct arblk)+bsiz);
+		if (bsiz == l && a->blks)	/* big request; keep the current block */
+			{
+			b->next = a->blks->next;
+			a->blks->next = b;
+			z = (char *) (b+1);
+			memset(z,0,l);
+			return z;
+			}
+		b->next = a->blks;
+		a->blks = b;
+		a->ptr = (char *) (b+1);
+		a->end = a->ptr+bsiz;
+		}
+	z = a->ptr;
+	a->ptr += l;
+	memset(z,0,l);
+	return z;
+}
+
+/* get an empty linked list header in an arena */
+
+table arnewtable(struct arena *a)
+{
+table list = aralloc(a,sizeof *list);
+
+	list->last = (Node) list;
+	return list;
+}
+
+/* add a node to the end of a linked list in an arena */
+
+void araddnode(struct arena *a,table list,void *dat)
+{
+Node n = aralloc(a,sizeof *n);
+
+	n->dat = dat;
+	n->last = list->last;
+	list->last->next = n;
+	list->last = n;
+}
+
+/* keep a file descriptor open until an arena is freed */
+
+void araddfd(struct arena *a,int fd)
+{
+struct arfd *f = aralloc(a,sizeof *f);
+
+	f->fd = fd;
+	f->next = a->fds;
+	a->fds = f;
+}
+
+/* free an arena and everything allocated from it */
+
+void freearena(struct arena *a)
+{
+struct arblk *b,*next;
+struct arfd *f;
+
+	for (f = a->fds; f; f = f->next)
+		close(f->fd);
+	for (b = a->blks; b; b = next)
+		{
+		next = b->next;
+		free(b);
+		}
+	free(a);
+}
+
 /* add a node to the end of a linked list */
 
 void addnode(table list,void *str)
@@ -239,8 +416,8 @@ void *dat;
 		nd->next->last = nd->last;
 	else
 		list->last = nd->last;
-	free(nd);
 	dat = nd->dat;
+	free(nd);
 	return dat;
 }
 
@@ -1,13 +1,19 @@
 table newtable();
 htable newhtable(int size);
-int hasher(char *s) /* copied from Programming in C++, p14 */;
+unsigned hasher(char *s);
 void addhnode(char *nam,void *dat,htable ht,void (*freefunc)(void *));
-void expandhtab(htable ht);
 void *gethnode(char *nam,htable ht);
+struct hnode *nexthnode(htable ht,int *pos);
 void freehtab(htable ht,void (*freefunc)(void *));
 void *remhnode(char *nam,htable ht);
 void *zalloc(int l);
 void *alloc(int l);
+struct arena *newarena(void);
+void *aralloc(struct arena *a,int l);
+table arnewtable(struct arena *a);
+void araddnode(struct arena *a,table list,void *dat);
+void araddfd(struct arena *a,int fd);
+void freearena(struct arena *a);
 void addnode(table list,void *str);
 void insnode(table list,Node last,void *dat);
 void *remnode(table list,Node nd);
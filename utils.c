@@ -36,6 +36,7 @@
 #include <errno.h>
 #include <sys/dir.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 /* add vars to the parm hash table */
 
@@ -246,6 +247,10 @@ char *t;
 		return rand() & 0x7fff;
 	if (!strcmp(s,"LINENO"))
 		return lineno;
+	if (!strcmp(s,"PARSEBYTES"))
+		return parsebytes;
+	if (!strcmp(s,"PARSENODES"))
+		return parsenodes;
 	if (!strcmp(s,"SECONDS"))
 		return time(NULL)-shtimer;
 	if (pmn = gethnode(s,parmhtab))
@@ -287,6 +292,13 @@ struct pmnode *pmn;
 		sprintf(buf,"%d",lineno);
 		return buf;
 		}
+	if (!strcmp(s,"PARSEBYTES") || !strcmp(s,"PARSENODES"))
+		{
+		static char buf[12];
+
+		sprintf(buf,"%ld",(s[5] == 'B') ? parsebytes : parsenodes);
+		return buf;
+		}
 	if (!strcmp(s,"RANDOM"))
 		{
 		static char buf[8];
@@ -418,22 +430,40 @@ char *pptr = getparm("CDPATH"),*ptr;
 
 int source(char *s)
 {
-int fd,cj = curjob,iact = opts[INTERACTIVE];
-FILE *obshin = bshin;
+int fd,cj = curjob,iact = opts[INTERACTIVE],olineno = lineno;
+struct inbuf *obshin = bshin;
+struct zwcfile *ozwcin = zwcin;
+char *oscriptname = scriptname;
 
 	fd = SHIN;
 	opts[INTERACTIVE] = OPT_UNSET;
-	if ((SHIN = movefd(open(s,O_RDONLY))) == -1)
+	scriptname = s;
+	lineno = 0;
+	if (zwcin = openzwc(s))	/* run the compiled file if it is up to date */
 		{
-		SHIN = fd;
-		curjob = cj;
-		opts[INTERACTIVE] = iact;
-		return 1;
+		loop();
+		closezwc(zwcin);
 		}
-	bshin = fdopen(SHIN,"r");
-	loop();
-	fclose(bshin);
+	else
+		{
+		if ((SHIN = movefd(open(s,O_RDONLY))) == -1)
+			{
+			SHIN = fd;
+			curjob = cj;
+			opts[INTERACTIVE] = iact;
+			zwcin = ozwcin;
+			scriptname = oscriptname;
+			lineno = olineno;
+			return 1;
+			}
+		bshin = inopen(SHIN);
+		loop();
+		inclose(bshin);
+		}
+	zwcin = ozwcin;
 	opts[INTERACTIVE] = iact;
+	scriptname = oscriptname;
+	lineno = olineno;
 	bshin = obshin;
 	SHIN = fd;
 	peek = EMPTY;
@@ -780,7 +810,8 @@ void scanjobs(void)
 {
 int t0;
 
-	for (t0 = 1; t0 != MAXJOB; t0++)
+	handlesigs();
+	for (t0 = 1; t0 != maxjob; t0++)
 		if (jobtab[t0].stat & STAT_CHANGED)
 			printjob(jobtab+t0,0);
 }
@@ -796,8 +827,11 @@ struct schnode *sch,*schl;
 
 	if (unset(NOTIFY))
 		scanjobs();
+	else
+		handlesigs();
 	if (errflag)
 		return;
+	checkchtab();
 	if (list = gethnode("precmd",shfunchtab))
 		newrunlist(list);
 	if (errflag)
@@ -940,49 +974,373 @@ char *s = getparm("MAILPATH"),*v,*u,c,d;
 		}
 }
 
-/* create command hash table */
+/* create command hash table.  It starts with just the builtins; the
+	directories in the path are read into it by hashcmd() as lookups
+	get that far down the path.  Directories that can't be read are
+	reported here, once, rather than by every subshell that looks
+	through them. */
 
 void createchtab(void)
 {
-int t0,dot = 0;
-struct direct *de;
+int t0;
 DIR *dir;
-struct chnode *cc;
 
 	holdintr();
 	if (chtab)
+		{
 		freehtab(chtab,freechnode);
+		freehtab(nocmdtab,freestr);
+		free(pathtime);
+		}
 	chtab = newhtable(101);
+	nocmdtab = newhtable(17);
+	pathtime = zalloc((pathct+1)*sizeof(time_t));
 	for (t0 = 0; t0 != pathct; t0++)
-		if (!strcmp(".",path[t0]))
-			{
+		{
+		pathtime[t0] = -1;
+		if (!strcmp(path[t0],"."))
+			continue;
+		if (dir = opendir(path[t0]))
+			closedir(dir);
+		else
+			zerr("%e: %s",errno,path[t0]);
+		}
+	pathscan = 0;
+	addintern(chtab);
+	noholdintr();
+}
+
+/* the name of $HASHFILE when it was opened, where it is mapped, and
+	which file it was, 0 if there was none */
+
+static char *hashfile,*hashbase,*hashend;
+static dev_t hashdev;
+static ino_t hashino;
+
+static void closehashfile(void)
+{
+	if (hashbase)
+		munmap(hashbase,hashend-hashbase);
+	if (hashfile)
+		free(hashfile);
+	hashfile = hashbase = hashend = NULL;
+	hashdev = hashino = 0;
+}
+
+/* map $HASHFILE, unless it is the file already mapped */
+
+static void openhashfile(void)
+{
+char *s = getparm("HASHFILE"),*m;
+struct stat st;
+int fd;
+
+	if (s && hashfile && !strcmp(s,hashfile))
+		return;
+	closehashfile();
+	if (!s || !*s)
+		return;
+	hashfile = strdup(s);
+	if ((fd = open(s,O_RDONLY)) == -1)
+		return;
+	if (fstat(fd,&st) == -1)
+		{
+		close(fd);
+		return;
+		}
+	hashdev = st.st_dev;
+	hashino = st.st_ino;
+	if (st.st_size < sizeof(long) ||
+			(m = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0)) ==
+			(char *) MAP_FAILED)
+		{
+		close(fd);
+		return;
+		}
+	close(fd);
+	if (*(long *) m != HASH_MAGIC)
+		{
+		munmap(m,st.st_size);
+		return;
+		}
+	hashbase = m;
+	hashend = m+st.st_size;
+}
+
+/* get the record after the one at p in $HASHFILE, or NULL if
+	there isn't a whole one */
+
+static char *nexthashrec(char *p)
+{
+struct hashrec *r = (struct hashrec *) p;
+char *s;
+
+	if (hashend-p < sizeof *r || r->nlen <= 0 || r->len < 0 ||
+			hashend-p-sizeof *r < HASHPAD(r->nlen)+HASHPAD(r->len))
+		return NULL;
+	s = (char *) (r+1);
+	if (s[r->nlen-1] || (r->len && s[HASHPAD(r->nlen)+r->len-1]))
+		return NULL;
+	return s+HASHPAD(r->nlen)+HASHPAD(r->len);
+}
+
+/* find the listing of a directory in $HASHFILE, if it is up to date */
+
+static struct hashrec *gethashrec(char *nam,struct stat *st)
+{
+struct hashrec *r;
+char *p,*next;
+
+	for (p = hashbase+sizeof(long); next = nexthashrec(p); p = next)
+		{
+		r = (struct hashrec *) p;
+		if (!strcmp((char *) (r+1),nam))
+			return (r->dev == st->st_dev && r->ino == st->st_ino &&
+				r->mtime == st->st_mtime) ? r : NULL;
+		}
+	return NULL;
+}
+
+/* put the listing of path[t0] in $HASHFILE, with the other
+	directories already there.  The new file is written under a new
+	name of its own and renamed, so that no shell ever sees half of
+	it.  Every shell replaces the file this way, so if it is not the
+	one we read any more, another shell has written it meanwhile;
+	rather than drop what it added, we leave ours out this time. */
+
+static void writehashfile(int t0,struct stat *st,char *buf,int len)
+{
+char tmp[MAXPATHLEN],pad[sizeof(long)],*p,*next;
+long magic = HASH_MAGIC;
+struct hashrec r;
+struct stat cur;
+FILE *out;
+int err,fd,mask;
+
+	closehashfile();
+	openhashfile();	/* another shell may have added to it */
+	if (!hashfile || strlen(hashfile)+8 > MAXPATHLEN)
+		return;
+	sprintf(tmp,"%s.XXXXXX",hashfile);
+	if ((fd = mkstemp(tmp)) == -1)
+		return;
+	mask = umask(0);	/* mkstemp makes it 0600; others may share it */
+	umask(mask);
+	fchmod(fd,0666 & ~mask);
+	if (!(out = fdopen(fd,"w")))
+		{
+		close(fd);
+		unlink(tmp);
+		return;
+		}
+	fwrite(&magic,sizeof magic,1,out);
+	if (hashbase)
+		for (p = hashbase+sizeof(long); next = nexthashrec(p); p = next)
+			if (strcmp(p+sizeof r,path[t0]))
+				fwrite(p,1,next-p,out);
+	memset(&r,0,sizeof r);
+	memset(pad,0,sizeof pad);
+	r.dev = st->st_dev;
+	r.ino = st->st_ino;
+	r.mtime = st->st_mtime;
+	r.nlen = strlen(path[t0])+1;
+	r.len = len;
+	fwrite(&r,sizeof r,1,out);
+	fwrite(path[t0],1,r.nlen,out);
+	fwrite(pad,1,HASHPAD(r.nlen)-r.nlen,out);
+	fwrite(buf,1,len,out);
+	fwrite(pad,1,HASHPAD(len)-len,out);
+	err = ferror(out);
+	if (fclose(out) == EOF || err)
+		err = 1;
+	else if (stat(hashfile,&cur) == -1)
+		err = hashino != 0;
+	else
+		err = cur.st_dev != hashdev || cur.st_ino != hashino;
+	if (err || rename(tmp,hashfile))
+		unlink(tmp);
+	closehashfile();
+}
+
+/* add a command in path[t0] to the command hash table, unless it
+	was found in an earlier directory */
+
+static void hashname(char *nam,int t0,int dot)
+{
+struct chnode *cc;
+
+	if (cc = gethnode(nam,chtab))
+		{
+		if (cc->dir <= t0)
+			return;
+		free(cc->u.nam);	/* kept for its globstat; see unhashdirs */
+		}
+	else
+		{
+		cc = alloc(sizeof(struct chnode));
+		cc->globstat = GLOB;
+		addhnode(strdup(nam),cc,chtab,freechnode);
+		}
+	cc->type = (dot) ? EXCMD_POSTDOT : EXCMD_PREDOT;
+	cc->dir = t0+1;
+	cc->u.nam = tricat(path[t0],"/",nam);
+}
+
+/* read path[t0] into the command hash table, from $HASHFILE if it
+	is there and up to date */
+
+static void hashdir(int t0)
+{
+int dot = 0,t1,len = 0,siz = 0;
+struct direct *de;
+struct stat st;
+struct hashrec *r;
+char *buf = NULL,*s,*e;
+DIR *dir;
+
+	for (t1 = 0; t1 != t0; t1++)
+		if (!strcmp(path[t1],"."))
 			dot = 1;
-			break;
+	if (!strcmp(path[t0],"."))
+		return;
+	holdintr();
+	pathtime[t0] = (stat(path[t0],&st)) ? 0 : st.st_mtime;
+
+	/* if it was changed this second, it might be changed again
+		without the time changing, so read it again next time */
+
+	if (pathtime[t0] >= time(NULL))
+		pathtime[t0] = -1;
+	openhashfile();
+	if (hashbase && pathtime[t0] > 0 && (r = gethashrec(path[t0],&st)))
+		{
+		s = (char *) (r+1)+HASHPAD(r->nlen);
+		for (e = s+r->len; s != e; s += strlen(s)+1)
+			hashname(s,t0,dot);
+		noholdintr();
+		return;
+		}
+	if (!(dir = opendir(path[t0])))	/* reported by createchtab() */
+		{
+		noholdintr();
+		return;
+		}
+	while (de = readdir(dir))
+		{
+		if (de->d_name[0] == '.' && (!de->d_name[1] ||
+				(de->d_name[1] == '.' && !de->d_name[2])))
+			continue;
+		hashname(de->d_name,t0,dot);
+		if (hashfile && pathtime[t0] > 0)
+			{
+			t1 = strlen(de->d_name)+1;
+			if (len+t1 > siz)
+				buf = realloc(buf,siz = (len+t1)*2);
+			strcpy(buf+len,de->d_name);
+			len += t1;
 			}
-	for (t0 = pathct-1; t0 >= 0; t0--)
-		if (!strcmp(".",path[t0]))
-			dot = 0;
+		}
+	closedir(dir);
+	if (buf)
+		{
+		writehashfile(t0,&st,buf,len);
+		free(buf);
+		}
+	noholdintr();
+}
+
+/* forget what was read from path[t0] and the directories after it.
+	Commands with their own globstat are kept, but not found again
+	until they are seen in one of those directories. */
+
+static void unhashdirs(int t0)
+{
+struct hnode *hn;
+struct chnode *cc;
+int pos = 0;
+
+	holdintr();
+	while (hn = nexthnode(chtab,&pos))
+		{
+		cc = hn->dat;
+		if (cc->dir <= t0)
+			continue;
+		if (cc->globstat != GLOB)
+			cc->dir = pathct+1;
 		else
+			freechnode(remhnode(hn->nam,chtab));
+		}
+	for (; t0 != pathct; t0++)
+		pathtime[t0] = -1;
+	freehtab(nocmdtab,freestr);
+	nocmdtab = newhtable(17);
+	noholdintr();
+}
+
+/* check whether any directory read into the command hash table has
+	been changed since, and if so forget it and the ones after it.
+	Returns nonzero if one has. */
+
+int checkchtab(void)
+{
+struct stat st;
+int t0;
+
+	pathcheck = time(NULL);
+	for (t0 = 0; t0 != pathscan; t0++)
+		if (strcmp(path[t0],".") &&
+				((stat(path[t0],&st)) ? 0 : st.st_mtime) != pathtime[t0])
 			{
-			dir = opendir(path[t0]);
-			if (!dir)
-				{
-				zerr("%e: %s",errno,path[t0]);
-				continue;
-				}
-			readdir(dir); readdir(dir);
-			while (de = readdir(dir))
-				{
-				cc = alloc(sizeof(struct chnode));
-				cc->type = (dot) ? EXCMD_POSTDOT : EXCMD_PREDOT;
-				cc->globstat = GLOB;
-				cc->u.nam = tricat(path[t0],"/",de->d_name);
-				addhnode(strdup(de->d_name),cc,chtab,freechnode);
-				}
-			closedir(dir);
+			unhashdirs(t0);
+			pathscan = t0;
+			return 1;
 			}
-	addintern(chtab);
-	noholdintr();
+	return 0;
+}
+
+/* get the command hash table entry for a command, reading the
+	directories in the path until it is found.  The directories
+	already read are checked for changes and read again, so that new
+	commands are found without a rehash: when it isn't found anywhere,
+	and when it is found after the first directory, since one that
+	comes earlier may have got a command of the same name.  They
+	needn't be checked if they were this second and nothing has been
+	run since, so a lookup made again, or by a builtin such as unhash
+	or noglob, costs only a hash table lookup. */
+
+struct chnode *hashcmd(char *nam)
+{
+struct chnode *cc;
+int checked = 0;
+
+	if (strchr(nam,'/'))
+		return NULL;
+	for (;;)
+		{
+		if ((cc = gethnode(nam,chtab)) && cc->dir <= pathscan)
+			{
+			if (cc->dir <= 1 || checked++ || pathcheck == time(NULL) ||
+					!checkchtab())
+				return cc;
+			continue;
+			}
+		if (gethnode(nam,nocmdtab) && (checked++ ||
+				pathcheck == time(NULL) || !checkchtab()))
+			return NULL;
+		if (pathscan != pathct)
+			hashdir(pathscan++);
+		else if (checked++ || !checkchtab())
+			return NULL;
+		}
+}
+
+/* read all of the path into the command hash table */
+
+void fillchtab(void)
+{
+	checkchtab();
+	while (pathscan != pathct)
+		hashdir(pathscan++);
 }
 
 void freechnode(void *a)
@@ -1007,23 +1365,9 @@ struct anode *c = (struct anode *) a;
 	free(c);
 }
 
-void freeredir(void *a)
-{
-struct fnode *f = (struct fnode *) a;
-
-	if (f)
-		{
-		if (f->type == HEREDOC)
-			close(f->u.fd2);
-		else
-			free(f->u.name);
-		free(f);
-		}
-}
-
 void freeshfunc(void *a)
 {
-	freelist((list) a);
+	unreflist((list) a);
 }
 
 void freepm(void *a)
@@ -1296,6 +1640,8 @@ char *getltext(list l)
 {
 char *s,*t,*u;
 
+	if (!l->left)		/* only the code is left */
+		return getwltext(l);
 	s = getl2text(l->left);
 	if (l->type == ASYNC)
 		{
@@ -1433,10 +1779,16 @@ char *s,*t,u = '=';
 
 char *getfortext(struct fornode *n,comm comm)
 {
-char *s,*t,*u,*v;
+char *s,*t,*u,*v,buf[40];
 
 	s = getltext(n->list);
-	u = dyncat((comm->type == CFOR) ? "for " : "select ",n->name);
+	if (n->par)
+		{
+		sprintf(buf,"for -P %d %s",n->par,(n->grpout) ? "-O " : "");
+		u = dyncat(buf,n->name);
+		}
+	else
+		u = dyncat((comm->type == CFOR) ? "for " : "select ",n->name);
 	if (comm->args)
 		{
 		t = makehlist(comm->args,0);
@@ -1594,7 +1946,7 @@ void spckcmd(char **s)
 {
 char *t;
 
-	if (gethnode(*s,chtab) || gethnode(*s,shfunchtab))
+	if (hashcmd(*s) || gethnode(*s,shfunchtab))
 		return;
 	for (t = *s; *t; t++)
 		if (*t == '/')
@@ -1604,6 +1956,7 @@ char *t;
 	best = NULL;
 	guess = *s;
 	d = 3;
+	fillchtab();
 	listhtable(chtab,spscan);
 	listhtable(shfunchtab,spscan);
 	if (best)
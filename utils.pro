@@ -28,10 +28,12 @@ void checkmail(void);
 void checkfirstmail(void);
 void checkmailpath(void);
 void createchtab(void);
+int checkchtab(void);
+struct chnode *hashcmd(char *nam);
+void fillchtab(void);
 void freechnode(void *a);
 void freestr(void *a);
 void freeanode(void *a);
-void freeredir(void *a);
 void freeshfunc(void *a);
 void freepm(void *a);
 void restoretty(void);
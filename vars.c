@@ -33,7 +33,7 @@
 
 /* buffered shell input for non-interactive shells */
 
-FILE *bshin;
+struct inbuf *bshin;
 
 /* null-terminated array of pointers to strings containing elements
 	of PATH and CDPATH */
@@ -95,13 +95,15 @@ table curtab;
 
 table dirstack;
 
-/* a string containing all the ungot characters (hungetch()) */
+/* the characters put back into the input (hungetch()), as a stack;
+	the next one to read is ungots[ungotct-1].  ungots is ungotbuf
+	unless it had to grow */
 
-char *ungots;
+char ungotbuf[UNGOTSIZ],*ungots = ungotbuf;
 
-/* the pointer to the next character to read from ungots */
+/* # of characters in ungots, and its size */
 
-char *ungotptr;
+int ungotct,ungotsiz = UNGOTSIZ;
 
 /* the contents of the IFS parameter */
 
@@ -152,13 +154,39 @@ htable parmhtab;
 
 htable chtab;
 
+/* hash table of commands not found in the path */
+
+htable nocmdtab;
+
+/* modification times of the path directories when they were read
+	into chtab, or -1 */
+
+time_t *pathtime;
+
+/* number of path directories read into chtab */
+
+int pathscan;
+
+/* when the path directories were last checked for changes, or 0 if a
+	process has been started since */
+
+time_t pathcheck;
+
 /* hash table containing the shell functions */
 
 htable shfunchtab;
 
 /* the job table */
 
-struct jobnode jobtab[MAXJOB];
+struct jobnode *jobtab;
+
+/* size of the job table */
+
+int maxjob;
+
+/* the self-pipe the signal handler writes to */
+
+int sigfds[2] = {-1,-1};
 
 /* the list of sched jobs pending */
 
@@ -311,6 +339,34 @@ int opts[128];
 
 int lineno;
 
+/* the script or sourced file being read, or NULL */
+
+char *scriptname;
+
+/* the shell function being run, or NULL */
+
+char *curfunc;
+
+/* where ztrace writes its records, or -1 */
+
+int tracefd = -1;
+
+/* the arena the parser is allocating in */
+
+struct arena *parena;
+
+/* PARSEBYTES, PARSENODES: memory used by the last parse */
+
+long parsebytes,parsenodes;
+
+/* compiled file being read by loop(), or NULL */
+
+struct zwcfile *zwcin;
+
+/* compiled file being written by zcompile, or NULL */
+
+FILE *zwcout;
+
 /* != 0 means we have called execlist() and then intend to exit(),
 	so don't fork if not necessary */
 
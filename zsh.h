@@ -51,9 +51,9 @@
 
 #define FOREVER for(;;)
 
-/* size of job table */
+/* initial size of job table */
 
-#define MAXJOB 16
+#define JOBTABSIZ 16
 
 void *realloc(void *,int),*malloc(int),*calloc(int,int);
 
@@ -176,6 +176,22 @@ struct xlist {
    Node first,last;
    };
 
+/* a region parse trees are allocated from; it is freed all at once */
+
+#define ARBLKSIZ 2048
+
+struct arblk {
+	struct arblk *next;
+	};
+struct arfd {
+	struct arfd *next;
+	int fd;
+	};
+struct arena {
+	struct arblk *blks;	/* blocks, most recent first */
+	char *ptr,*end;		/* free space in the current block */
+	struct arfd *fds;		/* here documents, closed with the arena */
+	};
 
 typedef struct pnode *pline;
 typedef struct lnode *list;
@@ -189,6 +205,11 @@ struct lnode {
    struct l2node *left;
    struct lnode *right;
    int type;
+   int refs;		/* extra holders of a shell function body */
+   struct arena *arena;	/* region a shell function body lives in */
+   struct prog *prog;	/* compiled form of this list, if any */
+   int pc;				/* where in prog->code it starts */
+   int lineno;			/* the line it starts on, for zprof */
    };
 
 enum ltype {
@@ -286,6 +307,9 @@ struct fornode {		/* for/select */
 	char *name;			/* parameter to assign values to */
 	list list;			/* list of names to loop through */
 	int inflag;			/* != 0 if 'in ...' was specified */
+	int par;				/* for -P: iterations to run at once */
+	int grpout;			/* for -O: != 0 to keep each iteration's
+										output together */
 	};
 struct casenode {		/* arg list of cnode struct contains word to test */
 	struct casenode *next;	/* next pattern */
@@ -307,6 +331,107 @@ struct repeatnode {
 	list list;
 	};
 
+/* wordcode: a flat encoding of a parse tree.  A list is a
+	sequence of WC_LIST words each followed by a chain of WC_SUBLIST
+	words, each of which is followed by a chain of WC_PIPE words, each
+	of which is followed by a WC_CMD.  Sublists, pipes and commands
+	are followed by their length in words, so they can be skipped.
+	A command is then followed by its tree index, name, arguments,
+	redirections and assignments; compound commands add their
+	control structure after that, with each list prefixed by its
+	length.  Strings are offsets into the string table; WC_NONE
+	stands for a null pointer. */
+
+typedef unsigned int wordcode;
+
+#define WC_LIST 1		/* type is SYNC or ASYNC; flag 1 is set on the last,
+								and the flags above it are the lnode's lineno */
+#define WC_SUBLIST 2	/* type is END, ORNEXT or ANDNEXT; flags are PFLAGs */
+#define WC_PIPE 3		/* type is END or PIPE */
+#define WC_CMD 4		/* type is the ctype; flags are CFLAGs */
+
+#define WCB(c,t,f) ((c)|((t)<<4)|((f)<<8))
+#define wc_code(w) ((w) & 15)
+#define wc_type(w) (((w) >> 4) & 15)
+#define wc_flags(w) ((w) >> 8)
+#define WC_NONE ((wordcode) ~0)
+
+struct prog {
+	wordcode *code;		/* the instructions */
+	char *strs;				/* the strings they refer to */
+	comm *trees;			/* parse trees of the compound commands */
+	int len,slen,ntrees;	/* sizes of the above */
+	int heredocs;			/* # of here documents, which can't be saved */
+	struct arena *arena;	/* where missing trees are decoded into */
+	};
+
+/* a stage of a pipeline being run, either from its tree or, when
+	prog is set, from its code */
+
+struct pstage {
+	pline pl;
+	struct prog *prog;
+	wordcode *pc;			/* the WC_PIPE word of the stage */
+	};
+
+/* buffer used while compiling */
+
+struct wcbuf {
+	wordcode *code;
+	char *strs;
+	comm *trees;
+	int len,slen,ntrees,heredocs;
+	int csiz,ssiz,tsiz;
+	};
+
+/* compiled files written by zcompile.  A header is followed by
+	records, one for each list in the file and one for each function
+	defined while parsing it, in the order the parser saw them.  A
+	record is followed by the function name, the code and the
+	strings, each padded to a whole number of words. */
+
+#define ZWC_MAGIC 0x7a776301	/* "zwc\1" */
+#define ZWC_VERSION 4
+
+struct zwchdr {
+	wordcode magic;
+	wordcode version;
+	long mtime;				/* mtime of the source file */
+	long size;				/* size of the source file */
+	};
+
+struct zwcrec {
+	int type;				/* ZWC_LIST or ZWC_FUNC */
+	int flags;				/* for functions, != 0 if the body is empty */
+	int len,slen,ntrees,nlen;	/* sizes of code, strings, trees, name */
+	wordcode sum;			/* of the fields above, name, code and strings */
+	};
+
+#define ZWC_LIST 0
+#define ZWC_FUNC 1
+
+#define ZWCPAD(n) (((n)+sizeof(wordcode)-1) & ~(sizeof(wordcode)-1))
+
+/* a compiled file being sourced */
+
+struct zwcfile {
+	char *base;				/* where it is mapped */
+	char *ptr,*end;		/* next record and end of the file */
+	};
+
+/* the file named by $HASHFILE keeps the listings of the path
+	directories, so that a new shell needn't read them.  It is a
+	long, HASH_MAGIC, and then a hashrec for each directory, followed
+	by its name and by the names in it, each null-terminated; the
+	name and the names are each padded to a multiple of a long. */
+
+#define HASH_MAGIC 0x7a686301L	/* "zhc\1" */
+#define HASHPAD(n) (((n)+sizeof(long)-1) & ~(sizeof(long)-1))
+
+struct hashrec {
+	long dev,ino,mtime;	/* of the directory when it was read */
+	int nlen,len;			/* sizes of its name and of the names in it */
+	};
 
 /* structure used for multiple i/o redirection */
 /* one for each fd open */
@@ -324,6 +449,7 @@ struct chnode
 {
 	int type;
 	int globstat;		/* status of filename gen for this command */
+	int dir;		/* 1 + index in path of the directory it is in, or 0 */
 	union {
 		char *nam;		/* full pathname if type != BUILTIN */
 		int (*func)();	/* func to exec if type == BUILTIN */
@@ -376,11 +502,14 @@ extern struct ttyinfo shttyinfo;
 struct jobnode {
 	long gleader;					/* process group leader of this job */
 	int stat;
+	int val;							/* exit status, once it is done */
 	char *cwd;						/* current working dir of shell when
 											this job was spawned */
 	struct procnode *procs;		/* list of processes */
 	table filelist;				/* list of files to delete when done */
 	struct ttyinfo ttyinfo;		/* saved tty state */
+	int gen;							/* gen of the last dead job with this
+											number; kept by freejob() */
 	};
 
 #define STAT_CHANGED 1		/* status changed and not reported */
@@ -390,13 +519,65 @@ struct jobnode {
 #define STAT_LOCKED 16		/* shell is finished creating this job,
 										may be deleted from job table */
 #define STAT_INUSE 64		/* this job entry is in use */
+#define STAT_NOTOURS 128	/* job was started by the shell this
+										subshell was forked from */
 
 #define SP_RUNNING -1		/* fake statusp for running jobs */
 
+/* profiling totals for a function or script line */
+
+struct profnode {
+	long calls;
+	double total,self;			/* wall clock seconds, with and without
+										the functions it called */
+	double cpu,selfcpu;			/* CPU seconds, likewise */
+	};
+
+/* a function or line being profiled */
+
+struct profframe {
+	struct profframe *prev;		/* the one of its kind that ran it */
+	double wall,cpu;				/* times when it started */
+	double cwall,ccpu;			/* time spent in the ones it ran */
+	};
+
+/* keys for zprof -k */
+
+#define PROF_SELF 0
+#define PROF_TOTAL 1
+#define PROF_CPU 2
+#define PROF_SELFCPU 3
+#define PROF_CALLS 4
+#define PROF_NAME 5
+
+#define TRACEIDLEN 48		/* room for a trace record's id, "pid.n" */
+
+/* a background job that finished before anyone waited for it */
+
+struct deadjob {
+	int job;							/* its entry in the job table */
+	long pid;						/* pid of its last process */
+	int stat;						/* its exit status */
+	int gen;							/* its number among the dead jobs with
+											this job number */
+	};
+
+#define MAXDEAD 1024			/* most dead jobs to remember */
+
+/* an iteration of a parallel for loop */
+
+struct forjob {
+	int job;							/* its job, or 0 if this slot is free */
+	int fd;							/* its output file if -O, or -1 */
+	int num;							/* which iteration it is */
+	};
+
 /* node in job process lists */
 
 struct procnode {
 	struct procnode *next;
+	struct procnode *hchain;	/* next in the same pidtab bucket */
+	int job;							/* job table entry of this process */
 	long pid;
 	char *text;						/* text to print when 'jobs' is run */
 	int statusp;					/* return code from wait3() */
@@ -414,8 +595,10 @@ struct procnode {
 
 											That's two procnodes in the parent
 											shell, the latter having this flag set. */
-	struct timeval ru_utime;
-	struct timeval ru_stime;
+	struct rusage ru;				/* resource usage from wait3() */
+	char *trace;					/* its trace record so far, if ztrace
+											is on, else NULL */
+	double tstart;					/* when it was started, for ztrace */
 	time_t bgtime;					/* time job was spawned */
 	time_t endtime;				/* time job exited */
 	};
@@ -439,26 +622,32 @@ struct schnode {
 	};
 
 #define MAXAL 20	/* maximum number of aliases expanded at once */
+#define UNGOTSIZ 256	/* initial size of the pushback stack */
 
 typedef struct xhtab *htable;
 
 /* node in hash table */
 
 struct hnode {
-	struct hnode *hchain;
-	char *nam;
+	char *nam;				/* NULL if this slot is empty */
 	void *dat;
+	unsigned hval;			/* hasher(nam) */
 	};
 
-/* hash table structure */
+/* hash table structure; open addressing with linear probing */
 
 struct xhtab {
-	int hsize,ct;
-	struct hnode **nodes;	 /* array of size hsize */
+	int hsize,ct;			/* slots in nodes (a power of 2), entries */
+	int used;				/* slots in nodes not empty, incl. deleted ones */
+	struct hnode *nodes;	/* array of size hsize */
+	struct hnode *old;	/* while resizing, the array being moved
+									into nodes, else NULL */
+	int osize,opos;		/* its size, and how much has been moved */
 	};
 
 typedef struct xpath *qath;	/* used in globbing - see glob.c */
 typedef struct xcomp *comp;	/* "" */
+typedef struct xscan *scan;	/* "" */
 
 extern char *sys_errlist[];
 extern int errno;
@@ -501,6 +690,7 @@ extern int errno;
 #define IGNOREBRACES 'I'
 #define CDABLEVARS 'J'
 #define NOBANGHIST 'K'
+#define PROFILE 'L'
 
 #define ALSTAT_MORE 1	/* last alias ended with ' ' */
 #define ALSTAT_JUNK 2	/* don't put word in history list */
@@ -545,7 +735,17 @@ extern int errno;
 
 /* buffered shell input for non-interactive shells */
 
-extern FILE *bshin;
+struct inbuf {
+	int fd;
+	char *buf;				/* the buffer */
+	char *ptr,*end;		/* next char and end of the data read */
+	int siz;					/* size of buf */
+	int eof;					/* != 0 once read() has returned 0 */
+	};
+
+#define INBUFSIZ 65536
+
+extern struct inbuf *bshin;
 
 /* null-terminated array of pointers to strings containing elements
 	of PATH and CDPATH */
@@ -607,13 +807,15 @@ extern table curtab;
 
 extern table dirstack;
 
-/* a string containing all the ungot characters (hungetch()) */
+/* the characters put back into the input (hungetch()), as a stack;
+	the next one to read is ungots[ungotct-1].  ungots is ungotbuf
+	unless it had to grow */
 
-extern char *ungots;
+extern char ungotbuf[],*ungots;
 
-/* the pointer to the next character to read from ungots */
+/* # of characters in ungots, and its size */
 
-extern char *ungotptr;
+extern int ungotct,ungotsiz;
 
 /* the contents of the IFS parameter */
 
@@ -664,13 +866,39 @@ extern htable parmhtab;
 
 extern htable chtab;
 
+/* hash table of commands not found in the path */
+
+extern htable nocmdtab;
+
+/* modification times of the path directories when they were read
+	into chtab, or -1 */
+
+extern time_t *pathtime;
+
+/* number of path directories read into chtab */
+
+extern int pathscan;
+
+/* when the path directories were last checked for changes, or 0 if a
+	process has been started since */
+
+extern time_t pathcheck;
+
 /* hash table containing the shell functions */
 
 extern htable shfunchtab;
 
 /* the job table */
 
-extern struct jobnode jobtab[MAXJOB];
+extern struct jobnode *jobtab;
+
+/* size of the job table */
+
+extern int maxjob;
+
+/* the self-pipe the signal handler writes to */
+
+extern int sigfds[2];
 
 /* the list of sched jobs pending */
 
@@ -823,6 +1051,34 @@ extern int opts[128];
 
 extern int lineno;
 
+/* the script or sourced file being read, or NULL */
+
+extern char *scriptname;
+
+/* the shell function being run, or NULL */
+
+extern char *curfunc;
+
+/* where ztrace writes its records, or -1 */
+
+extern int tracefd;
+
+/* the arena the parser is allocating in */
+
+extern struct arena *parena;
+
+/* PARSEBYTES, PARSENODES: memory used by the last parse */
+
+extern long parsebytes,parsenodes;
+
+/* compiled file being read by loop(), or NULL */
+
+extern struct zwcfile *zwcin;
+
+/* compiled file being written by zcompile, or NULL */
+
+extern FILE *zwcout;
+
 /* != 0 means we have called execlist() and then intend to exit(),
  	so don't fork if not necessary */
 